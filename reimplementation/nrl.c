@@ -1,7 +1,8 @@
 // license:All rights Reserved (for now, contact about licensing if you need it)
 // copyright-holders:Jonathan Gevaryahu
 // Reimplementation of the Naval Research Laboratory's Text to Phoneme ruleset parser.
-// Preliminary version using NRL ruleset, this is very incomplete.
+// Preliminary version using NRL ruleset; translates text to IPA phonemes, and those on to Votrax phonemes and their
+// ASCII codes.
 // Copyright (C)2021-2024 Jonathan Gevaryahu
 #include <stdio.h>
 #include <stdint.h>
@@ -25,6 +26,8 @@ typedef uint64_t u64;
 #define RULES_TOTAL 28
 #define RULES_PUNCT 0
 #define RULES_NUMBERS 27
+// the IPA to Votrax rules have a table for punctuation and one for each IPA phoneme
+#define RULES_IPA_TOTAL 42
 
 // verbose macro
 #define e_printf(v, ...) \
@@ -32,46 +35,118 @@ typedef uint64_t u64;
 
 // verbosity defines; V_DEBUG can be changed here to enable/disable debug messages
 #define V_DEBUG (1)
-#define V_0 (c.verbose & (1<<0))
-#define V_1 (c.verbose & (1<<1))
+#define V_0 (c.verbose & (1<<0)) // phrase debug messages
+#define V_1 (c.verbose & (1<<1)) // which rule translated each character
 
 // 'global' struct
 typedef struct s_cfg
 {
 	//const char* const letters;
 	u32 verbose;
+	bool ids; // processPhrase writes IPA phoneme IDs (see compileIpaIds) rather than text
 } s_cfg;
 
+// a bump allocator for the scratch buffers of a phrase: allocations are carved off the front of one block, and all of
+// them are released at once by resetting it. whatever doesn't fit in the block comes from the heap until the next
+// reset, which then enlarges the block to what the phrase needed, so once the block fits the longest phrase, no more
+// memory is allocated or freed while translating.
+typedef struct arena_spill
+{
+	struct arena_spill* next;
+} arena_spill;
+
+typedef struct arena
+{
+	u8* base;
+	u32 size;
+	u32 used;
+	u64 spilled; // bytes allocated from the heap since the last reset, because the block was full
+	arena_spill* spill; // those allocations, each behind a header of ARENA_ALIGN bytes
+} arena;
+
+#define ARENA_ALIGN 16
+
+bool arenaInit(arena* a, u32 size)
+{
+	a->base = malloc(size);
+	a->size = a->base ? size : 0;
+	a->used = 0;
+	a->spilled = 0;
+	a->spill = NULL;
+	return (a->base != NULL);
+}
+
+// returns NULL if the block is full and the heap is out of memory
+u8* arenaAlloc(arena* a, u32 n)
+{
+	const u64 len = ((u64)n + (ARENA_ALIGN-1)) & ~(u64)(ARENA_ALIGN-1);
+	if (a->used + len <= a->size)
+	{
+		u8* const r = a->base + a->used;
+		a->used += len;
+		return r;
+	}
+	arena_spill* const s = malloc(ARENA_ALIGN + len);
+	if (!s) return NULL;
+	s->next = a->spill;
+	a->spill = s;
+	a->spilled += len;
+	return (u8*)s + ARENA_ALIGN;
+}
+
+// release everything allocated since the last reset
+void arenaReset(arena* a)
+{
+	if (a->spill)
+	{
+		while (a->spill)
+		{
+			arena_spill* const next = a->spill->next;
+			free(a->spill);
+			a->spill = next;
+		}
+		u64 size = a->used + a->spilled;
+		if (size > ((u32)~0)) size = ((u32)~0);
+		free(a->base);
+		arenaInit(a, size);
+	}
+	a->used = 0;
+	a->spilled = 0;
+}
+
+void arenaFree(arena* a)
+{
+	arenaReset(a);
+	free(a->base);
+	a->base = NULL;
+	a->size = 0;
+}
+
 // 'vector' structs for holding data
-/*
+// the input is handled as bytes; the rules only ever deal with 7-bit characters
 typedef struct vec_u8
 {
 	u32 elements; // number of elements in the vector, defaults to zero/empty
 	u32 capacity; // amount of element-sized memory blocks currently allocated for the vector; i.e. capacity
 	u8* data;
-} vec_u8;*/
-
-typedef struct vec_char32
-{
-	u32 elements; // number of elements in the vector, defaults to zero/empty
-	u32 capacity; // amount of element-sized memory blocks currently allocated for the vector; i.e. capacity
-	char32_t* data;
-} vec_char32;
+	arena* pool; // the arena the data is in, if it isn't on the heap; such a vector is only valid until the arena is reset
+} vec_u8;
 
-vec_char32* vec_char32_alloc(u32 init_len)
+vec_u8* vec_u8_alloc(u32 init_len)
 {
 	// allocate and initialize the vector
-	vec_char32 *r = malloc(sizeof(vec_char32));
+	vec_u8 *r = malloc(sizeof(vec_u8));
 	r->elements = 0;
 	r->capacity = 0;
+	r->pool = NULL;
 	// allocate the data pointer, and since the data is a direct type, this allocation contains the data itself
-	r->data = malloc(init_len * sizeof(char32_t));
+	r->data = malloc(init_len * sizeof(u8));
 	// fill in the capacity; if malloc failed (or init_len was zero), capacity remains 0 and the data pointer is NULL
 	if (r->data) r->capacity = init_len;
 	return r;
 }
 
-void vec_char32_free(vec_char32* l)
+void vec_u8_free(vec_u8* l)
 {
 	//free the structs that the data pointer points to, sequentially. (not necessary with this structure)
 	//for (int i = 0; i < l->capacity; i++)
@@ -85,9 +160,30 @@ void vec_char32_free(vec_char32* l)
 	free(l);
 }
 
-void vec_char32_resize(vec_char32* l, u32 capacity)
+// set up a vector in an arena; there is nothing to free, the arena being reset does away with it
+void vec_u8_init_arena(vec_u8* l, arena* a, u32 init_len)
+{
+	l->elements = 0;
+	l->pool = a;
+	l->data = arenaAlloc(a, init_len);
+	l->capacity = l->data ? init_len : 0;
+}
+
+void vec_u8_resize(vec_u8* l, u32 capacity)
 {
-	char32_t* new_data = realloc(l->data, sizeof(l->data[0]) * capacity);
+	if (l->pool)
+	{
+		// the old data stays in the arena until it is reset
+		u8* new_data = arenaAlloc(l->pool, sizeof(l->data[0]) * capacity);
+		if (new_data)
+		{
+			memcpy(new_data, l->data, (l->elements < capacity) ? l->elements : capacity);
+			l->capacity = capacity;
+			l->data = new_data;
+		}
+		return;
+	}
+	u8* new_data = realloc(l->data, sizeof(l->data[0]) * capacity);
 	if (new_data) // make sure it actually allocated...
 	{
 		l->capacity = capacity; // update to the new capacity
@@ -95,7 +191,7 @@ void vec_char32_resize(vec_char32* l, u32 capacity)
 	}
 }
 
-void vec_char32_append(vec_char32* l, char32_t a)
+void vec_u8_append(vec_u8* l, u8 a)
 {
 	// if current vector capacity is insufficient to have another element added to it, reallocate it to twice its current capacity
 	if (l->elements == l->capacity)
@@ -103,7 +199,7 @@ void vec_char32_append(vec_char32* l, char32_t a)
 		u32 old_capacity = l->capacity;
 		u64 new_capacity = l->capacity<<1;
 		if ((new_capacity > ((u32)~0)) && (old_capacity <= ((u32)~0))) new_capacity = ((u32)~0); // if we would have exceeded a u32 but there's still headroom, realloc to max possible u32 size
-		vec_char32_resize(l, new_capacity);
+		vec_u8_resize(l, new_capacity);
 		if (l->capacity == old_capacity) return; // unable to resize properly, just bail out instead of doing bad things
 	}
 	// stick the new element on the end of the list and update the number of elements
@@ -111,14 +207,14 @@ void vec_char32_append(vec_char32* l, char32_t a)
 	l->elements++;
 }
 
-void vec_char32_dbg_stats(vec_char32* l)
+void vec_u8_dbg_stats(vec_u8* l)
 {
-	e_printf(V_DEBUG,"DEBUG: vec_char32 capacity: %d, elements: %d\n", l->capacity, l->elements);
+	e_printf(V_DEBUG,"DEBUG: vec_u8 capacity: %d, elements: %d\n", l->capacity, l->elements);
 }
 
-void vec_char32_dbg_print(vec_char32* l)
+void vec_u8_dbg_print(vec_u8* l)
 {
-	e_printf(V_DEBUG,"DEBUG: vec_char32 contents: '");
+	e_printf(V_DEBUG,"DEBUG: vec_u8 contents: '");
 	for (u32 i=0; i < l->elements; i++)
 	{
 		e_printf(V_DEBUG,"%c", (char)l->data[i]);
@@ -130,8 +226,8 @@ void vec_char32_dbg_print(vec_char32* l)
 typedef struct sym_ruleset
 {
 	u32 num_rules;
-	//u32* const * ruleLen;
 	const char* const * rule;
+	struct nrl_rule* compiled; // the rules split up and compiled by compileRuleset
 } sym_ruleset;
 
 // 'vector' struct for holding a list of strings
@@ -233,18 +329,19 @@ bool isFront(char32_t in)
 	return false;
 }
 
-// preprocess a vec_char32* list into another vec_char32* list starting at a given offset, return the final offset+1
-u32 preprocess(vec_char32* in, vec_char32* out, u32 in_offset)
+// preprocess a vec_u8* list into another vec_u8* list starting at a given offset, return the final offset+1
+u32 preprocess(vec_u8* in, vec_u8* out, u32 in_offset)
 {
 	// prepend a space to output
-	vec_char32_append(out, ' ');
+	vec_u8_append(out, ' ');
 	// iterate over input
 	u32 i;
 	for (i = in_offset; i < in->elements; i++)
 	{
 		if (in->data[i] == '#') // early return: end marker
 		{
-			return i+1;
+			i++;
+			break;
 		}
 		else if (isIllegalPunct(in->data[i]))
 		{
@@ -254,27 +351,34 @@ u32 preprocess(vec_char32* in, vec_char32* out, u32 in_offset)
 		else if (isPunctNoSpace(in->data[i])) // special case for punctuation
 		{
 			//e_printf(V_DEBUG,"got non-space punctuation of '%c'\n",in->data[i]);
-			vec_char32_append(out, ' ');
-			vec_char32_append(out, in->data[i]);
-			vec_char32_append(out, ' ');
+			if (out->data[out->elements-1] != ' ')
+			{
+				vec_u8_append(out, ' ');
+			}
+			vec_u8_append(out, in->data[i]);
+			vec_u8_append(out, ' ');
 		}
-		else if (in->data[i] == ' ') // special case for space, make sure we do not append successive spaces
+		else if (isspace(in->data[i])) // special case for space, and any other blank such as a line break; make sure we do not append successive spaces
 		{
 			//e_printf(V_DEBUG,"got space punctuation of '%c'\n",in->data[i]);
 			if ((out->elements > 0) && (out->data[out->elements-1] != ' '))
 			{
-				vec_char32_append(out, in->data[i]);
+				vec_u8_append(out, ' ');
 			}
 		}
 		else if (isalpha(in->data[i]) || isdigit(in->data[i]))
 		{
 			//e_printf(V_DEBUG,"got alphanumeric of '%c'\n",in->data[i]);
-			vec_char32_append(out, toupper(in->data[i]));
+			vec_u8_append(out, toupper(in->data[i]));
 		}
 		else e_printf(V_DEBUG,"Unknown character 0x%x in input stream\n", in->data[i]);
 	}
-	// reached end of input, i.e. an implicit '#'
-	return i; // we incremented past the end of input, so just return i
+	// end the phrase with a blank, as TRANS does before its end marker, so the last word is delimited too
+	if (out->data[out->elements-1] != ' ')
+	{
+		vec_u8_append(out, ' ');
+	}
+	return i;
 }
 
 u32 getRuleNum(char32_t input)
@@ -329,127 +433,571 @@ s32 strnfind(const char *src, int c, size_t n)
 #define FRONT '+'
 #define CONS0M ':'
 
-bool matchRule(const char const rule, const char32_t const input)
+// character features, one bit per class of characters which a symbol can match
+#define F_VOWEL (1<<0)
+#define F_CONS (1<<1)
+#define F_VOICED (1<<2)
+#define F_FRONT (1<<3)
+#define F_EI (1<<4)
+#define F_SIBIL (1<<5)
+#define F_NONPAL (1<<6)
+static u8 features[256];
+
+void initFeatures()
+{
+	for (u32 i = 0; i < 256; i++)
+	{
+		features[i] = (isVowel(i) ? F_VOWEL : 0)
+			| (isConsonant(i) ? F_CONS : 0)
+			| (isVoiced(i) ? F_VOICED : 0)
+			| (isFront(i) ? F_FRONT : 0)
+			| (((i == 'E') || (i == 'I')) ? F_EI : 0)
+			| ((i && strchr("SCGZXJ", i)) ? F_SIBIL : 0)
+			| ((i && strchr("TSRDLZNJ", i)) ? F_NONPAL : 0);
+	}
+}
+
+// what each symbol matches, as in the SPECIALBREAK patterns of TRANS.SPT: any one of up to five strings, in which a
+// lowercase letter stands for one character of a class: v(owel), c(onsonant), d (voiced), f(ront), e (E or I),
+// s(ibilant) or n(onpalate)
+typedef struct nrl_symbol
 {
+	char symbol;
+	bool repeat; // the symbol may match any number of times in a row
+	bool optional; // the symbol may match nothing at all
+	const char* alt[5];
+} nrl_symbol;
 
+static const nrl_symbol symbols[] =
+{
+	{ VOWEL1M, true, false, { "v" } },
+	{ CONS1M, true, false, { "c" } },
+	{ VOICED, false, false, { "d" } },
+	{ CONS1IE, false, false, { "ce" } },
+	{ SUFFIX, false, false, { "ER ", "E ", "ES ", "ED ", "ING " } },
+	{ SIBIL, false, false, { "s", "CH", "SH" } },
+	{ NONPAL, false, false, { "n", "TH", "CH", "SH" } },
+	{ CONS1, false, false, { "c" } },
+	{ FRONT, false, false, { "f" } },
+	{ CONS0M, true, true, { "c" } },
+};
+#define NUM_SYMBOLS (sizeof(symbols)/sizeof(*symbols))
+
+u8 classMask(const char code)
+{
+	switch(code)
+	{
+		case 'v': return F_VOWEL;
+		case 'c': return F_CONS;
+		case 'd': return F_VOICED;
+		case 'f': return F_FRONT;
+		case 'e': return F_EI;
+		case 's': return F_SIBIL;
+		case 'n': return F_NONPAL;
+		default: return 0;
+	}
 }
 
-bool parseLeft(const char* const rule, const vec_char32* const input, const u32 rpinit, const u32 inpos)
+// maximum number of character positions in one compiled rule context
+#define CONTEXT_POSITIONS 32
+
+// a left or right rule context compiled into a position automaton: each position matches one character, either a
+// literal one or any of a class, and the context has matched as soon as one of the positions in last has.
+// the left context is compiled reversed, since it is matched backwards from the character before the bracketed part.
+typedef struct nrl_context
+{
+	u32 num_pos;
+	bool nullable; // the context matches the empty string, so it always matches
+	u32 first; // positions which can match the first character
+	u32 last; // positions which can match the final character
+	u32 follow[CONTEXT_POSITIONS]; // positions which can match the character after the one each position matched
+	u8 mask[CONTEXT_POSITIONS]; // the feature bits of the class each position matches, or 0 for a literal
+	u8 literal[CONTEXT_POSITIONS]; // the character each position matches if its mask is 0
+} nrl_context;
+
+// maximum number of characters of ASCII codes for the Votrax phonemes of one rule
+#define RULE_ASCII_MAX 16
+// maximum number of IPA phoneme IDs of one rule
+#define RULE_IDS_MAX 16
+
+// a rule of the form BACK[CHARDEF]FOR=PHONEME, split up and with its contexts compiled
+typedef struct nrl_rule
+{
+	const char* text; // the rule as written, for debug messages
+	const char* chardef; // the bracketed characters, which the rule translates
+	u32 chardef_len;
+	const char* phoneme; // the phonemes, everything after the '='
+	u32 phoneme_len;
+	nrl_context left;
+	nrl_context right;
+	char ascii[RULE_ASCII_MAX]; // for the IPA to Votrax rules, the ASCII codes of the Votrax phonemes, see compileAsciiCodes
+	u32 ascii_len;
+	u8 ids[RULE_IDS_MAX]; // for the English rules, the IDs of the IPA phonemes, see compileIpaIds
+	u32 ids_len;
+} nrl_rule;
+
+// compile a rule context; a character which isn't a symbol matches itself. returns false if the context is too long.
+bool compileContext(nrl_context* const ctx, const char* const str, const u32 len, const bool reverse)
 {
-	// rule[rulepos] points to the rule symbol being evaluated
-	// input->data[inpos] points to the input symbol being evaluated
-	s32 rulepos = rpinit;
-	// the leftmost valid input character is technically inpos of 0
-	while (rulepos > 0)
+	memset(ctx, 0, sizeof(*ctx));
+	ctx->nullable = true;
+	// the positions which can match the final character of everything compiled so far
+	u32 last = 0;
+	for (u32 n = 0; n < len; n++)
 	{
-		bool rulepass = false;
-		switch(rule[rulepos])
+		const char sym = str[reverse ? (len - 1 - n) : n];
+		const char lit_str[2] = { sym, 0 };
+		nrl_symbol lit = { sym, false, false, { lit_str } };
+		const nrl_symbol* s = &lit;
+		for (u32 i = 0; i < NUM_SYMBOLS; i++)
 		{
-			case VOWEL1M: // 1 or more vowels
-				if (isVowel(input->data[inpos]))
-				{
-					rulepass = true;
-					// we got at least one vowel, call this function repeatedly in a loop
-					// consuming more vowels from input-1 until either input-1 becomes -1 OR
-					// we hit a non-vowel, then terminate and leave inpos at that failing position
-				}
-			case CONS1:
-				break; // TODO
-			
+			if (symbols[i].symbol == sym) s = &symbols[i];
+		}
+		// add a chain of positions for each alternative of the symbol
+		u32 sym_first = 0;
+		u32 sym_last = 0;
+		for (u32 a = 0; (a < 5) && s->alt[a]; a++)
+		{
+			const char* const alt = s->alt[a];
+			const u32 alt_len = strlen(alt);
+			s32 prev = -1;
+			for (u32 k = 0; k < alt_len; k++)
+			{
+				if (ctx->num_pos == CONTEXT_POSITIONS) return false;
+				const u32 p = ctx->num_pos++;
+				ctx->literal[p] = alt[reverse ? (alt_len - 1 - k) : k];
+				ctx->mask[p] = (s == &lit) ? 0 : classMask(ctx->literal[p]);
+				if (prev < 0) sym_first |= 1u<<p;
+				else ctx->follow[prev] |= 1u<<p;
+				prev = p;
+			}
+			sym_last |= 1u<<prev;
+		}
+		// link the symbol to itself if it repeats, and to whatever came before it
+		for (u32 p = 0; p < ctx->num_pos; p++)
+		{
+			if (s->repeat && (sym_last & (1u<<p))) ctx->follow[p] |= sym_first;
+			if (last & (1u<<p)) ctx->follow[p] |= sym_first;
 		}
+		if (ctx->nullable) ctx->first |= sym_first;
+		last = sym_last | (s->optional ? last : 0);
+		ctx->nullable = ctx->nullable && s->optional;
 	}
-	return false;
+	ctx->last = last;
+	return true;
 }
 
-bool parseRight()
+// split a rule into its parts and compile its contexts; returns false for an invalid rule
+bool compileRule(nrl_rule* const r, const char* const text)
 {
-	return false;
+	const u32 len = strlen(text);
+	const s32 left = strnfind(text, '[', len);
+	if (left < 0) return false;
+	const s32 right = strnfind(text + left + 1, ']', len - left - 1) + left + 1;
+	if (right <= left + 1) return false; // no ']', or nothing between the brackets
+	const s32 equals = strnfind(text + right + 1, '=', len - right - 1) + right + 1;
+	if (equals <= right) return false;
+	r->text = text;
+	r->chardef = text + left + 1;
+	r->chardef_len = right - left - 1;
+	r->phoneme = text + equals + 1;
+	r->phoneme_len = len - equals - 1;
+	r->ascii_len = 0;
+	r->ids_len = 0;
+	return compileContext(&r->left, text, left, true)
+		&& compileContext(&r->right, text + right + 1, equals - right - 1, false);
 }
 
-bool parseRule(const char* const rule, const vec_char32* const input, const u32 inpos)
+// compile every rule of every one of num_tables tables, or report the first invalid one and return false
+bool compileRuleset(sym_ruleset* const ruleset, const u32 num_tables)
 {
-	// find left end
-	s32 left = strnfind(rule, '[', ruleLen);
-	if (left != 0)
+	for (u32 t = 0; t < num_tables; t++)
 	{
-		// match left part of rule
-		// early out: if the rule is not ':' which is 'zero or more' of a symbol
-		//   AND this is the leftmost character of the input string, just die immediately
-		//   and fail the rule, otherwise continue
-		if ((rule[left-1] != CONS0) && (inpos == 0))
+		ruleset[t].compiled = malloc(sizeof(nrl_rule) * ruleset[t].num_rules);
+		if (!ruleset[t].compiled)
 		{
+			fprintf(stderr,"E* Failure to allocate memory for rules, aborting!\n"); fflush(stderr);
 			return false;
 		}
-		// call parseLeft which recursively calls itself and returns true if the rule matches and false if it doesn't.
-		if (!parseLeft(rule, input, left-1, inpos))
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
 		{
-			return false;
+			if (!compileRule(&ruleset[t].compiled[i], ruleset[t].rule[i]))
+			{
+				fprintf(stderr,"E* Invalid rule %s!\n", ruleset[t].rule[i]); fflush(stderr);
+				return false;
+			}
 		}
 	}
-	e_printf(V_DEBUG,"Left half of rule %s matched input string %s at offset %d\n", rule, input, inpos);
-	// find right end
-	s32 right = strnfind(rule, ']', ruleLen);
-	if (rule[right+1] != '=')
+	return true;
+}
+
+void freeRuleset(sym_ruleset* const ruleset, const u32 num_tables)
+{
+	for (u32 t = 0; t < num_tables; t++)
+	{
+		free(ruleset[t].compiled);
+		ruleset[t].compiled = NULL;
+	}
+}
+
+// the ASCII code of each Votrax phoneme, from the .CODE table of TRANS.SPT
+typedef struct votrax_code
+{
+	const char* name;
+	const char* code;
+} votrax_code;
+
+static const votrax_code votrax_codes[] =
+{
+	{ "PA0", "CH" }, { "PA1", "NK" }, { "A", "@J" }, { "A1", "FH" }, { "A2", "EH" }, { "AE", "NJ" }, { "AE1", "OJ" },
+	{ "AH", "DJ" }, { "AH1", "EI" }, { "AH2", "HH" }, { "AW", "MK" }, { "AW1", "CI" }, { "AW2", "@K" }, { "AY", "AJ" },
+	{ "B", "NH" }, { "CH", "@I" }, { "D", "NI" }, { "DT", "DH" }, { "E", "LJ" }, { "E1", "LK" }, { "EH", "KK" },
+	{ "EH1", "BH" }, { "EH2", "AH" }, { "EH3", "@H" }, { "ER", "JK" }, { "F", "MI" }, { "G", "LI" }, { "H", "KI" },
+	{ "I", "GJ" }, { "I1", "KH" }, { "I2", "JH" }, { "I3", "IH" }, { "IU", "FK" }, { "J", "JI" }, { "K", "II" },
+	{ "L", "HI" }, { "M", "LH" }, { "N", "MH" }, { "NG", "DI" }, { "O", "FJ" }, { "O1", "EK" }, { "O2", "DK" },
+	{ "OO", "GI" }, { "OO1", "FI" }, { "P", "EJ" }, { "R", "KJ" }, { "S", "OI" }, { "SH", "AI" }, { "T", "JJ" },
+	{ "TH", "IK" }, { "THV", "HK" }, { "U", "HJ" }, { "U1", "GK" }, { "UH", "CK" }, { "UH1", "BK" }, { "UH2", "AK" },
+	{ "UH3", "CJ" }, { "V", "OH" }, { "W", "MJ" }, { "Y", "IJ" }, { "Y1", "BJ" }, { "Z", "BI" }, { "ZH", "GH" },
+};
+#define NUM_VOTRAX_CODES (sizeof(votrax_codes)/sizeof(*votrax_codes))
+
+// look up the ASCII code of each Votrax phoneme of every IPA to Votrax rule once, the way the ASCII routine of TRANS
+// does for each translation: the brackets become blanks, and each phoneme between the blanks is replaced by its code.
+// translating a phoneme to ASCII is then just a matter of copying the codes of the rule which translated it. reports
+// the first rule with an unknown phoneme and returns false.
+bool compileAsciiCodes(sym_ruleset* const ruleset, const u32 num_tables)
+{
+	for (u32 t = 0; t < num_tables; t++)
 	{
-		// call parseRight which recursively calls itself and returns true if the rule matches and false if it doesn't.
-		if (!parseright(rule, input, right+1, inpos))
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
 		{
-			return false;
+			nrl_rule* const r = &ruleset[t].compiled[i];
+			for (u32 k = 0; k < r->phoneme_len; )
+			{
+				u32 len = 0;
+				while ((k + len < r->phoneme_len) && !strchr("[] ", r->phoneme[k + len])) len++;
+				if (!len)
+				{
+					k++;
+					continue;
+				}
+				const votrax_code* code = NULL;
+				for (u32 n = 0; n < NUM_VOTRAX_CODES; n++)
+				{
+					if ((strlen(votrax_codes[n].name) == len) && !memcmp(votrax_codes[n].name, &r->phoneme[k], len)) code = &votrax_codes[n];
+				}
+				if (!code || (r->ascii_len + 2 > RULE_ASCII_MAX))
+				{
+					fprintf(stderr,"E* Unknown Votrax phoneme, or too many of them, in rule %s!\n", r->text); fflush(stderr);
+					return false;
+				}
+				memcpy(&r->ascii[r->ascii_len], code->code, 2);
+				r->ascii_len += 2;
+				k += len;
+			}
 		}
 	}
-	e_printf(V_DEBUG,"Right half of rule %s matched input string %s at offset %d\n", rule, input, inpos);
 	return true;
 }
 
-s32 applyRule(const char* const rule)
+// match a compiled context against the input from inpos on, going forwards (dir 1) for a right context or backwards
+// (dir -1) for a left one, and return whether it matched before running out of input.
+// SNOBOL would backtrack into every way of splitting the input between the repeating symbols (e.g. '#^:##'); instead,
+// every position which can have matched so far is tracked at once, so each input character is only looked at once.
+bool matchContext(const nrl_context* const ctx, const vec_u8* const input, s32 inpos, const s32 dir)
 {
-	u32 ruleLen = strlen(rule);
-	// search through the rule string for the [
-	s32 first = strnfind(rule, '[', ruleLen);
-	if (first == -1) return -1; // early out for invalid rule
-	// search through the rule string for the ]
-	s32 last = strnfind(rule, ']', ruleLen);
-	// return the number of characters between those two.
-	return (last-first)-1;
+	if (ctx->nullable) return true;
+	u32 next = ctx->first;
+	for (; (inpos >= 0) && (inpos < (s32)input->elements); inpos += dir)
+	{
+		const u8 in = input->data[inpos];
+		u32 matched = 0;
+		for (u32 p = 0; p < ctx->num_pos; p++)
+		{
+			if ((next & (1u<<p)) && (ctx->mask[p] ? (features[in] & ctx->mask[p]) : (in == ctx->literal[p])))
+			{
+				matched |= 1u<<p;
+			}
+		}
+		if (matched & ctx->last) return true;
+		if (!matched) return false;
+		next = 0;
+		for (u32 p = 0; p < ctx->num_pos; p++)
+		{
+			if (matched & (1u<<p)) next |= ctx->follow[p];
+		}
+	}
+	return false;
 }
 
-s32 processLetter(const sym_ruleset* const ruleset, const vec_char32* const input, const u32 inpos)
+// find the first rule of a table which matches the input at inpos, or NULL if none of them do
+const nrl_rule* matchRules(const sym_ruleset* const rules, const vec_u8* const input, const u32 inpos, const s_cfg c)
 {
-	// find ruleset for this letter/punct/etc
-	u32 rulenum = getRuleNum(input->data[inpos]);
 	// iterate over every one of these rules and halt on the first match
-	for (u32 i = 0; i < ruleset[rulenum].num_rules; i++)
+	for (u32 i = 0; i < rules->num_rules; i++)
+	{
+		const nrl_rule* const r = &rules->compiled[i];
+		if ((inpos + r->chardef_len > input->elements) || memcmp(&input->data[inpos], r->chardef, r->chardef_len))
+		{
+			continue;
+		}
+		// the left context must end right before inpos, but may start anywhere before that
+		if (!matchContext(&r->left, input, (s32)inpos - 1, -1)) continue;
+		if (!matchContext(&r->right, input, inpos + r->chardef_len, 1)) continue;
+		e_printf(V_1, "D* Rule %s matched at position %d\n", r->text, inpos);
+		return r;
+	}
+	return NULL;
+}
+
+// the IPA phoneme each table of the IPA to Votrax rules is for; table 0 (RULES_PUNCT) is for punctuation, as it is
+// for the English rules
+static const char* const ipa_symbols[RULES_IPA_TOTAL] =
+{
+	"", "IY", "IH", "EY", "EH", "AE", "AA", "AO", "OW", "UH", "UW", "ER", "AX", "AH", "AY", "AW", "OY", "Y", "P", "B",
+	"T", "D", "K", "G", "F", "V", "TH", "DH", "S", "Z", "SH", "ZH", "HH", "CH", "JH", "M", "N", "NX", "L", "W", "WH", "R",
+};
+
+// the IPA to Votrax table of each IPA phoneme, by its first letter and its second letter (or 26 if it only has one),
+// or -1 if there isn't one
+s8 ipa_index[26][27];
+
+void initIpaIndex()
+{
+	memset(ipa_index, -1, sizeof(ipa_index));
+	for (u32 t = 1; t < RULES_IPA_TOTAL; t++)
+	{
+		const char* const sym = ipa_symbols[t];
+		ipa_index[sym[0] - 'A'][sym[1] ? (sym[1] - 'A') : 26] = t;
+	}
+}
+
+// the IPA to Votrax table for the phoneme at inpos, which runs up to the next blank; as in TRANS, a phoneme which
+// starts with punctuation uses the punctuation table. returns -1 if there is no table for it.
+s32 getIpaRuleNum(const vec_u8* const input, const u32 inpos)
+{
+	const u8* const sym = &input->data[inpos];
+	if (isPunct(sym[0])) return RULES_PUNCT;
+	u32 len = 0;
+	while ((inpos + len < input->elements) && (sym[len] != ' ')) len++;
+	if ((len > 2) || !isupper(sym[0]) || ((len == 2) && !isupper(sym[1]))) return -1;
+	return ipa_index[sym[0] - 'A'][(len == 2) ? (sym[1] - 'A') : 26];
+}
+
+// the pauses of the English rules, which are IPA phonemes too
+static const char* const ipa_pauses[] = { "< >", "<,>", "<.>", "<?>", "<->" };
+#define NUM_IPA_PAUSES (sizeof(ipa_pauses)/sizeof(*ipa_pauses))
+
+// an IPA phoneme ID is a byte: the phoneme's table number (see ipa_symbols) for a phoneme, or RULES_IPA_TOTAL plus its
+// number in ipa_pauses for a pause. 0 is never a phoneme, and ends each phrase of the ID output.
+#define IPA_ID_END 0
+
+// split the phonemes of every English rule into IPA phoneme IDs once, so translating to IDs is a matter of copying
+// them. reports the first rule with an unknown phoneme and returns false.
+bool compileIpaIds(sym_ruleset* const ruleset, const u32 num_tables)
+{
+	for (u32 t = 0; t < num_tables; t++)
+	{
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
+		{
+			nrl_rule* const r = &ruleset[t].compiled[i];
+			for (u32 k = 0; k < r->phoneme_len; )
+			{
+				const char* const sym = &r->phoneme[k];
+				if ((*sym == '/') || (*sym == ' '))
+				{
+					k++;
+					continue;
+				}
+				s32 id = -1;
+				u32 len = 0;
+				if (*sym == '<')
+				{
+					len = 3;
+					for (u32 n = 0; n < NUM_IPA_PAUSES; n++)
+					{
+						if ((k + len <= r->phoneme_len) && !memcmp(ipa_pauses[n], sym, len)) id = RULES_IPA_TOTAL + n;
+					}
+				}
+				else
+				{
+					while ((k + len < r->phoneme_len) && isupper(sym[len])) len++;
+					if ((len == 1) || (len == 2)) id = ipa_index[sym[0] - 'A'][(len == 2) ? (sym[1] - 'A') : 26];
+				}
+				if ((id < 0) || (r->ids_len == RULE_IDS_MAX))
+				{
+					fprintf(stderr,"E* Unknown IPA phoneme, or too many of them, in rule %s!\n", r->text); fflush(stderr);
+					return false;
+				}
+				r->ids[r->ids_len++] = id;
+				k += len;
+			}
+		}
+	}
+	return true;
+}
+
+// append the text of n IPA phoneme IDs to the output, with a blank between each two phonemes
+void formatIpaIds(const u8* const ids, const u32 n, vec_u8* const output)
+{
+	for (u32 k = 0; k < n; k++)
 	{
-		e_printf(V_DEBUG, "found a rule %s\n", ruleset[rulenum].rule[i]);
-		if (applyRule(ruleset[rulenum].rule[i]) < 0)
+		const char* const sym = (ids[k] >= RULES_IPA_TOTAL) ? ipa_pauses[ids[k] - RULES_IPA_TOTAL] : ipa_symbols[ids[k]];
+		if (k) vec_u8_append(output, ' ');
+		for (const char* p = sym; *p; p++)
 		{
-			e_printf(V_DEBUG,"ERROR: encountered an invalid rule for character at position %d (%c)!\n", inpos, input->data[inpos]);
-			exit(1);
+			vec_u8_append(output, *p);
 		}
-		//e_printf(V_DEBUG, "this rule would consume %d characters\n", applyRule(ruleset[rulenum].rule[i]));
-		if (parseRule(ruleset[rulenum].rule[i], input, inpos))
+	}
+}
+
+// size of the window of IPA phonemes the IPA to Votrax stage works on
+#define IPA_WINDOW_SIZE 64
+
+// the IPA to Votrax stage, which the English rules hand their IPA phonemes to as they find them, rather than building
+// up the whole IPA string of a phrase first. the phonemes are laid out in a small window the way VOTRAXTRANSLATE lays
+// out the whole string: the slashes around them become blanks, and there is a single blank before the first phoneme,
+// between each two, and after the last. a phoneme is translated as soon as the window holds as much after it as any
+// rule looks at, and only as much before the next phoneme as any rule looks at is kept, so the window never grows.
+// the Votrax phonemes, or their ASCII codes, are appended to the output.
+typedef struct ipa_stage
+{
+	const sym_ruleset* ruleset;
+	bool ascii; // append the ASCII codes of the Votrax phonemes rather than the phonemes
+	u32 behind; // the most characters a rule looks at before the phoneme it translates
+	u32 ahead; // the most characters a rule looks at from the start of the phoneme it translates on
+	u32 curpos; // the window position of the next phoneme to translate
+	vec_u8 window; // its data is buf
+	u8 buf[IPA_WINDOW_SIZE];
+} ipa_stage;
+
+// get ready for the phonemes of the next phrase
+void ipaStageReset(ipa_stage* const st)
+{
+	st->buf[0] = ' ';
+	st->window.elements = 1;
+	st->curpos = 1;
+}
+
+// returns false if the rules look at too much around a phoneme for the window
+bool ipaStageInit(ipa_stage* const st, const sym_ruleset* const ruleset, const bool ascii)
+{
+	st->ruleset = ruleset;
+	st->ascii = ascii;
+	st->behind = 0;
+	st->ahead = 0;
+	// the IPA rule contexts are all literal, so each of their positions is one character
+	for (u32 t = 0; t < RULES_IPA_TOTAL; t++)
+	{
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
 		{
-			return applyRule(ruleset[rulenum].rule[i]);
+			const nrl_rule* const r = &ruleset[t].compiled[i];
+			if (r->left.num_pos > st->behind) st->behind = r->left.num_pos;
+			if (r->chardef_len + r->right.num_pos > st->ahead) st->ahead = r->chardef_len + r->right.num_pos;
 		}
 	}
-	return 0;
+	st->window.data = st->buf;
+	st->window.capacity = IPA_WINDOW_SIZE;
+	ipaStageReset(st);
+	if (st->behind + st->ahead + 2 > IPA_WINDOW_SIZE)
+	{
+		fprintf(stderr,"E* The IPA rule contexts are too long for the IPA window!\n"); fflush(stderr);
+		return false;
+	}
+	return true;
+}
+
+// translate the phoneme at curpos, and skip the blank after the phonemes the rule translated
+void ipaStageStep(ipa_stage* const st, vec_u8* const output, const s_cfg c)
+{
+	const vec_u8* const w = &st->window;
+	const s32 table = getIpaRuleNum(w, st->curpos);
+	const nrl_rule* const r = (table < 0) ? NULL : matchRules(&st->ruleset[table], w, st->curpos, c);
+	u32 translated = 0;
+	if (r)
+	{
+		const char* const out = st->ascii ? r->ascii : r->phoneme;
+		const u32 out_len = st->ascii ? r->ascii_len : r->phoneme_len;
+		for (u32 k = 0; k < out_len; k++)
+		{
+			vec_u8_append(output, out[k]);
+		}
+		translated = r->chardef_len;
+	}
+	else
+	{
+		// skip the whole phoneme
+		while ((st->curpos + translated < w->elements) && (w->data[st->curpos + translated] != ' ')) translated++;
+		e_printf(V_0,"WARNING: unable to match any rule for IPA phoneme %.*s!\n", translated, &w->data[st->curpos]);
+	}
+	st->curpos += translated + 1;
+}
+
+// hand IPA phonemes, as written by the English rules, to the stage
+void ipaStageFeed(ipa_stage* const st, const char* const ipa, const u32 len, vec_u8* const output, const s_cfg c)
+{
+	vec_u8* const w = &st->window;
+	for (u32 i = 0; i < len; i++)
+	{
+		const u8 ch = (ipa[i] == '/') ? ' ' : ipa[i];
+		if ((ch == ' ') && (w->data[w->elements-1] == ' ')) continue;
+		if (w->elements == IPA_WINDOW_SIZE)
+		{
+			// the window only ever fills up with more than ahead characters after curpos, so there's plenty to drop
+			const u32 drop = st->curpos - st->behind;
+			memmove(w->data, &w->data[drop], w->elements - drop);
+			w->elements -= drop;
+			st->curpos -= drop;
+		}
+		w->data[w->elements++] = ch;
+		while ((st->curpos < w->elements) && (w->elements - st->curpos > st->ahead)) ipaStageStep(st, output, c);
+	}
+}
+
+// translate the rest of the phonemes of the phrase
+void ipaStageFinish(ipa_stage* const st, vec_u8* const output, const s_cfg c)
+{
+	// the last phoneme is normally followed by a slash already
+	ipaStageFeed(st, "/", 1, output, c);
+	while (st->curpos < st->window.elements) ipaStageStep(st, output, c);
+	ipaStageReset(st);
 }
 
-void processPhrase(const sym_ruleset* const ruleset, const vec_char32* const input)
+// translate a preprocessed phrase, appending its phonemes (or their IDs, if c.ids is set) to the output, or if next is
+// set, handing them on to the IPA to Votrax stage as each is found
+void processPhrase(const sym_ruleset* const ruleset, const vec_u8* const input, vec_u8* const output, ipa_stage* const next, const s_cfg c)
 {
-	u32 curpos = 0;
-	e_printf(V_DEBUG, "processPhrase called, phrase has %d elements\n", input->elements);
-	while (curpos <= input->elements)
+	// position 0 is the blank inserted by preprocess to delimit the first word
+	u32 curpos = 1;
+	e_printf(V_0, "processPhrase called, phrase has %d elements\n", input->elements);
+	while (curpos < input->elements)
 	{
-		e_printf(V_DEBUG, "position is now %d (%c)\n", curpos, input->data[curpos]);
-		u32 oldpos = curpos;
-		curpos += processLetter(ruleset, input, curpos);
-		if (curpos - oldpos == 0)
+		// find ruleset for this letter/punct/etc
+		const nrl_rule* const r = matchRules(&ruleset[getRuleNum(input->data[curpos])], input, curpos, c);
+		if (!r)
 		{
-			e_printf(V_DEBUG,"WARNING: unable to match any rule for position %d (%c)!\n", curpos, input->data[curpos]);
+			e_printf(V_0,"WARNING: unable to match any rule for position %d (%c)!\n", curpos, input->data[curpos]);
 			curpos++;
+			continue;
 		}
+		if (next) ipaStageFeed(next, r->phoneme, r->phoneme_len, output, c);
+		else if (c.ids)
+		{
+			for (u32 k = 0; k < r->ids_len; k++)
+			{
+				vec_u8_append(output, r->ids[k]);
+			}
+		}
+		else
+		{
+			for (u32 k = 0; k < r->phoneme_len; k++)
+			{
+				vec_u8_append(output, r->phoneme[k]);
+			}
+		}
+		curpos += r->chardef_len;
 	}
+	if (next) ipaStageFinish(next, output, c);
 }
 
 void usage()
@@ -457,16 +1005,31 @@ void usage()
 	printf("Usage: executablename parameters\n");
 	printf("Brief explanation of function of executablename\n");
 	printf("\n");
+	printf("Each phrase of the input file, up to a '#' or the end of the file, is translated to IPA phonemes, and\n");
+	printf("optionally those on to Votrax phonemes or their ASCII codes, which are written to stdout on a line of their own.\n");
+	printf("\n");
+	printf("Options:\n");
+	printf("  -v <n>      verbosity bitmask: 1 phrase debug messages, 2 the rule which translated each character\n");
+	printf("  -t <name>   what to translate to: ipa (the default), votrax, ascii, or ids (IPA phoneme IDs, a byte\n");
+	printf("              per phoneme, and a 0 byte rather than a line break after each phrase)\n");
 }
 
 #define NUM_PARAMETERS 1
 
+// what the -t option translates the text to
+#define TARGET_IPA 0
+#define TARGET_VOTRAX 1
+#define TARGET_ASCII 2
+#define TARGET_IDS 3
+
 int main(int argc, char **argv)
 {
 	s_cfg c =
 	{
 		0, // verbose
+		false, // ids
 	};
+	u32 target = TARGET_IPA;
 
 	//{
 		const char* const punctrule_eng[] =
@@ -911,43 +1474,387 @@ int main(int argc, char **argv)
 		};
 		sym_ruleset ruleset[RULES_TOTAL] =
 		{
-			{ sizeof(punctrule_eng)/sizeof(*punctrule_eng), punctrule_eng },
-			{ sizeof(arule_eng)/sizeof(*arule_eng), arule_eng },
-			{ sizeof(brule_eng)/sizeof(*brule_eng), brule_eng },
-			{ sizeof(crule_eng)/sizeof(*crule_eng), crule_eng },
-			{ sizeof(drule_eng)/sizeof(*drule_eng), drule_eng },
-			{ sizeof(erule_eng)/sizeof(*erule_eng), erule_eng },
-			{ sizeof(frule_eng)/sizeof(*frule_eng), frule_eng },
-			{ sizeof(grule_eng)/sizeof(*grule_eng), grule_eng },
-			{ sizeof(hrule_eng)/sizeof(*hrule_eng), hrule_eng },
-			{ sizeof(irule_eng)/sizeof(*irule_eng), irule_eng },
-			{ sizeof(jrule_eng)/sizeof(*jrule_eng), jrule_eng },
-			{ sizeof(krule_eng)/sizeof(*krule_eng), krule_eng },
-			{ sizeof(lrule_eng)/sizeof(*lrule_eng), lrule_eng },
-			{ sizeof(mrule_eng)/sizeof(*mrule_eng), mrule_eng },
-			{ sizeof(nrule_eng)/sizeof(*nrule_eng), nrule_eng },
-			{ sizeof(orule_eng)/sizeof(*orule_eng), orule_eng },
-			{ sizeof(prule_eng)/sizeof(*prule_eng), prule_eng },
-			{ sizeof(qrule_eng)/sizeof(*qrule_eng), qrule_eng },
-			{ sizeof(rrule_eng)/sizeof(*rrule_eng), rrule_eng },
-			{ sizeof(srule_eng)/sizeof(*srule_eng), srule_eng },
-			{ sizeof(trule_eng)/sizeof(*trule_eng), trule_eng },
-			{ sizeof(urule_eng)/sizeof(*urule_eng), urule_eng },
-			{ sizeof(vrule_eng)/sizeof(*vrule_eng), vrule_eng },
-			{ sizeof(wrule_eng)/sizeof(*wrule_eng), wrule_eng },
-			{ sizeof(xrule_eng)/sizeof(*xrule_eng), xrule_eng },
-			{ sizeof(yrule_eng)/sizeof(*yrule_eng), yrule_eng },
-			{ sizeof(zrule_eng)/sizeof(*zrule_eng), zrule_eng },
-			{ sizeof(numberrule_eng)/sizeof(*numberrule_eng), numberrule_eng },
+			{ sizeof(punctrule_eng)/sizeof(*punctrule_eng), punctrule_eng, NULL },
+			{ sizeof(arule_eng)/sizeof(*arule_eng), arule_eng, NULL },
+			{ sizeof(brule_eng)/sizeof(*brule_eng), brule_eng, NULL },
+			{ sizeof(crule_eng)/sizeof(*crule_eng), crule_eng, NULL },
+			{ sizeof(drule_eng)/sizeof(*drule_eng), drule_eng, NULL },
+			{ sizeof(erule_eng)/sizeof(*erule_eng), erule_eng, NULL },
+			{ sizeof(frule_eng)/sizeof(*frule_eng), frule_eng, NULL },
+			{ sizeof(grule_eng)/sizeof(*grule_eng), grule_eng, NULL },
+			{ sizeof(hrule_eng)/sizeof(*hrule_eng), hrule_eng, NULL },
+			{ sizeof(irule_eng)/sizeof(*irule_eng), irule_eng, NULL },
+			{ sizeof(jrule_eng)/sizeof(*jrule_eng), jrule_eng, NULL },
+			{ sizeof(krule_eng)/sizeof(*krule_eng), krule_eng, NULL },
+			{ sizeof(lrule_eng)/sizeof(*lrule_eng), lrule_eng, NULL },
+			{ sizeof(mrule_eng)/sizeof(*mrule_eng), mrule_eng, NULL },
+			{ sizeof(nrule_eng)/sizeof(*nrule_eng), nrule_eng, NULL },
+			{ sizeof(orule_eng)/sizeof(*orule_eng), orule_eng, NULL },
+			{ sizeof(prule_eng)/sizeof(*prule_eng), prule_eng, NULL },
+			{ sizeof(qrule_eng)/sizeof(*qrule_eng), qrule_eng, NULL },
+			{ sizeof(rrule_eng)/sizeof(*rrule_eng), rrule_eng, NULL },
+			{ sizeof(srule_eng)/sizeof(*srule_eng), srule_eng, NULL },
+			{ sizeof(trule_eng)/sizeof(*trule_eng), trule_eng, NULL },
+			{ sizeof(urule_eng)/sizeof(*urule_eng), urule_eng, NULL },
+			{ sizeof(vrule_eng)/sizeof(*vrule_eng), vrule_eng, NULL },
+			{ sizeof(wrule_eng)/sizeof(*wrule_eng), wrule_eng, NULL },
+			{ sizeof(xrule_eng)/sizeof(*xrule_eng), xrule_eng, NULL },
+			{ sizeof(yrule_eng)/sizeof(*yrule_eng), yrule_eng, NULL },
+			{ sizeof(zrule_eng)/sizeof(*zrule_eng), zrule_eng, NULL },
+			{ sizeof(numberrule_eng)/sizeof(*numberrule_eng), numberrule_eng, NULL },
+		};
+
+		// the IPA to Votrax rules, one table per IPA phoneme in the order of ipa_symbols. the second EY rule is missing
+		// its closing bracket in TRANS.SPT too; the brackets are only there to be stripped off again.
+		const char* const punctrule_ipa[] =
+		{
+			"[< >]=[PA0]",
+			"[<,>]=[PA1]",
+			"[<.>]=[PA1 PA1]",
+			"[<?>]=[PA1 PA1]",
+			"[<->]=[PA1]",
+		};
+
+		const char* const iyrule_ipa[] =
+		{
+			"[IY]=[E]",
+		};
+
+		const char* const ihrule_ipa[] =
+		{
+			"[IH]=[I]",
+		};
+
+		const char* const eyrule_ipa[] =
+		{
+			"L [EY] R=[UH3 A1 I3]",
+			"L [EY]=[UH3 A1 AY",
+			"[EY] R=[A I3]",
+			"[EY]=[A AY]",
+		};
+
+		const char* const ehrule_ipa[] =
+		{
+			"L [EH]=[UH3 EH]",
+			"[EH]=[EH]",
+		};
+
+		const char* const aerule_ipa[] =
+		{
+			"L [AE] R=[UH3 AE EH3]",
+			"L [AE]=[UH3 AE]",
+			"[AE] R=[AE1 EH3]",
+			"[AE]=[AE]",
+		};
+
+		const char* const aarule_ipa[] =
+		{
+			"[AA]=[AH]",
+		};
+
+		const char* const aorule_ipa[] =
+		{
+			"L [AO] R=[UH3 O]",
+			"L [AO] ER=[UH3 AW O2]",
+			"L [AO]=[UH3 AW]",
+			"[AO] R=[O]",
+			"[AO] ER=[AW O2]",
+			"[AO]=[AW]",
+		};
+
+		const char* const owrule_ipa[] =
+		{
+			"L [OW]=[UH3 O1 U1]",
+			"[OW]=[O1 U1]",
+		};
+
+		const char* const uhrule_ipa[] =
+		{
+			"L [UH]=[UH3 OO]",
+			"[UH]=[OO]",
+		};
+
+		const char* const uwrule_ipa[] =
+		{
+			"[UW]=[IU U]",
+		};
+
+		const char* const errule_ipa[] =
+		{
+			"IY [ER]=[I3 ER]",
+			"ER [ER]=[IU R]",
+			"L [ER]=[UH3 ER]",
+			"[ER L]=[UH3 ER]",
+			"R [ER]=[UH3 R]",
+			"[ER]=[ER]",
+		};
+
+		const char* const axrule_ipa[] =
+		{
+			"[AX]=[UH2]",
+		};
+
+		const char* const ahrule_ipa[] =
+		{
+			"[AH]=[UH]",
+		};
+
+		const char* const ayrule_ipa[] =
+		{
+			"[AY] L=[AH AY]",
+			"[AY] R=[AH I3]",
+			"[AY] ER=[AH AY]",
+			"[AY]=[AH E1]",
+		};
+
+		const char* const awrule_ipa[] =
+		{
+			"[AW]=[AH O1]",
+		};
+
+		const char* const oyrule_ipa[] =
+		{
+			"L [OY] ER=[UH3 O1 AY]",
+			"L [OY] L=[UH3 O1 AY]",
+			"L [OY] R=[UH3 O1 EH2]",
+			"[OY] ER=[O1 AY]",
+			"[OY] L=[O1 AY]",
+			"[OY] R=[O1 EH2]",
+			"[OY]=[O1 E1]",
+		};
+
+		const char* const yrule_ipa[] =
+		{
+			"[Y]=[Y1]",
+		};
+
+		const char* const prule_ipa[] =
+		{
+			"[P]=[P]",
+		};
+
+		const char* const brule_ipa[] =
+		{
+			"[B]=[B]",
+		};
+
+		const char* const trule_ipa[] =
+		{
+			"[T]=[T]",
+		};
+
+		const char* const drule_ipa[] =
+		{
+			"[D]=[D]",
+		};
+
+		const char* const krule_ipa[] =
+		{
+			"[K]=[K]",
+		};
+
+		const char* const grule_ipa[] =
+		{
+			"[G]=[G]",
+		};
+
+		const char* const frule_ipa[] =
+		{
+			"[F]=[F]",
+		};
+
+		const char* const vrule_ipa[] =
+		{
+			"[V]=[V]",
+		};
+
+		const char* const thrule_ipa[] =
+		{
+			"[TH]=[TH]",
+		};
+
+		const char* const dhrule_ipa[] =
+		{
+			"[DH]=[THV]",
+		};
+
+		const char* const srule_ipa[] =
+		{
+			"[S]=[S]",
+		};
+
+		const char* const zrule_ipa[] =
+		{
+			"[Z]=[Z]",
+		};
+
+		const char* const shrule_ipa[] =
+		{
+			"[SH]=[SH]",
+		};
+
+		const char* const zhrule_ipa[] =
+		{
+			"[ZH]=[ZH]",
+		};
+
+		const char* const hhrule_ipa[] =
+		{
+			"[HH]=[H]",
+		};
+
+		const char* const chrule_ipa[] =
+		{
+			"[CH]=[T CH]",
+		};
+
+		const char* const jhrule_ipa[] =
+		{
+			"[JH]=[D J]",
+		};
+
+		const char* const mrule_ipa[] =
+		{
+			"[M]=[M]",
+		};
+
+		const char* const nrule_ipa[] =
+		{
+			"[N]=[N]",
+		};
+
+		const char* const nxrule_ipa[] =
+		{
+			"[NX]=[NG]",
+		};
+
+		const char* const lrule_ipa[] =
+		{
+			"IY [L]=[I3 L]",
+			"EY [L]=[I3 L]",
+			"AY [L]=[I3 L]",
+			"OY [L]=[I3 L]",
+			"AE [L]=[UH3 L]",
+			"AO [L]=[UH3 L]",
+			"OW [L]=[UH3 L]",
+			"[L]=[L]",
+		};
+
+		const char* const wrule_ipa[] =
+		{
+			"[W]=[W]",
+		};
+
+		const char* const whrule_ipa[] =
+		{
+			"[WH]=[H W]",
+		};
+
+		const char* const rrule_ipa[] =
+		{
+			"[R] L=[UH3 R]",
+			"[R]=[R]",
+		};
+
+		sym_ruleset ipa_ruleset[RULES_IPA_TOTAL] =
+		{
+			{ sizeof(punctrule_ipa)/sizeof(*punctrule_ipa), punctrule_ipa, NULL },
+			{ sizeof(iyrule_ipa)/sizeof(*iyrule_ipa), iyrule_ipa, NULL },
+			{ sizeof(ihrule_ipa)/sizeof(*ihrule_ipa), ihrule_ipa, NULL },
+			{ sizeof(eyrule_ipa)/sizeof(*eyrule_ipa), eyrule_ipa, NULL },
+			{ sizeof(ehrule_ipa)/sizeof(*ehrule_ipa), ehrule_ipa, NULL },
+			{ sizeof(aerule_ipa)/sizeof(*aerule_ipa), aerule_ipa, NULL },
+			{ sizeof(aarule_ipa)/sizeof(*aarule_ipa), aarule_ipa, NULL },
+			{ sizeof(aorule_ipa)/sizeof(*aorule_ipa), aorule_ipa, NULL },
+			{ sizeof(owrule_ipa)/sizeof(*owrule_ipa), owrule_ipa, NULL },
+			{ sizeof(uhrule_ipa)/sizeof(*uhrule_ipa), uhrule_ipa, NULL },
+			{ sizeof(uwrule_ipa)/sizeof(*uwrule_ipa), uwrule_ipa, NULL },
+			{ sizeof(errule_ipa)/sizeof(*errule_ipa), errule_ipa, NULL },
+			{ sizeof(axrule_ipa)/sizeof(*axrule_ipa), axrule_ipa, NULL },
+			{ sizeof(ahrule_ipa)/sizeof(*ahrule_ipa), ahrule_ipa, NULL },
+			{ sizeof(ayrule_ipa)/sizeof(*ayrule_ipa), ayrule_ipa, NULL },
+			{ sizeof(awrule_ipa)/sizeof(*awrule_ipa), awrule_ipa, NULL },
+			{ sizeof(oyrule_ipa)/sizeof(*oyrule_ipa), oyrule_ipa, NULL },
+			{ sizeof(yrule_ipa)/sizeof(*yrule_ipa), yrule_ipa, NULL },
+			{ sizeof(prule_ipa)/sizeof(*prule_ipa), prule_ipa, NULL },
+			{ sizeof(brule_ipa)/sizeof(*brule_ipa), brule_ipa, NULL },
+			{ sizeof(trule_ipa)/sizeof(*trule_ipa), trule_ipa, NULL },
+			{ sizeof(drule_ipa)/sizeof(*drule_ipa), drule_ipa, NULL },
+			{ sizeof(krule_ipa)/sizeof(*krule_ipa), krule_ipa, NULL },
+			{ sizeof(grule_ipa)/sizeof(*grule_ipa), grule_ipa, NULL },
+			{ sizeof(frule_ipa)/sizeof(*frule_ipa), frule_ipa, NULL },
+			{ sizeof(vrule_ipa)/sizeof(*vrule_ipa), vrule_ipa, NULL },
+			{ sizeof(thrule_ipa)/sizeof(*thrule_ipa), thrule_ipa, NULL },
+			{ sizeof(dhrule_ipa)/sizeof(*dhrule_ipa), dhrule_ipa, NULL },
+			{ sizeof(srule_ipa)/sizeof(*srule_ipa), srule_ipa, NULL },
+			{ sizeof(zrule_ipa)/sizeof(*zrule_ipa), zrule_ipa, NULL },
+			{ sizeof(shrule_ipa)/sizeof(*shrule_ipa), shrule_ipa, NULL },
+			{ sizeof(zhrule_ipa)/sizeof(*zhrule_ipa), zhrule_ipa, NULL },
+			{ sizeof(hhrule_ipa)/sizeof(*hhrule_ipa), hhrule_ipa, NULL },
+			{ sizeof(chrule_ipa)/sizeof(*chrule_ipa), chrule_ipa, NULL },
+			{ sizeof(jhrule_ipa)/sizeof(*jhrule_ipa), jhrule_ipa, NULL },
+			{ sizeof(mrule_ipa)/sizeof(*mrule_ipa), mrule_ipa, NULL },
+			{ sizeof(nrule_ipa)/sizeof(*nrule_ipa), nrule_ipa, NULL },
+			{ sizeof(nxrule_ipa)/sizeof(*nxrule_ipa), nxrule_ipa, NULL },
+			{ sizeof(lrule_ipa)/sizeof(*lrule_ipa), lrule_ipa, NULL },
+			{ sizeof(wrule_ipa)/sizeof(*wrule_ipa), wrule_ipa, NULL },
+			{ sizeof(whrule_ipa)/sizeof(*whrule_ipa), whrule_ipa, NULL },
+			{ sizeof(rrule_ipa)/sizeof(*rrule_ipa), rrule_ipa, NULL },
 		};
 	//}
-	if (argc != NUM_PARAMETERS+1)
+	if (argc < NUM_PARAMETERS+1)
 	{
 		fprintf(stderr,"E* Incorrect number of parameters!\n"); fflush(stderr);
 		usage();
 		return 1;
 	}
 
+	// handle optional parameters
+	u32 paramidx = NUM_PARAMETERS+1;
+	while (paramidx <= (argc-1))
+	{
+		switch (*(argv[paramidx]++))
+		{
+			case '-':
+				// skip this character.
+				break;
+			case 'v':
+				paramidx++;
+				if (paramidx == (argc-0)) { fprintf(stderr,"E* Too few arguments for -v parameter!\n"); usage(); exit(1); }
+				if (!sscanf(argv[paramidx], "%d", &c.verbose)) { fprintf(stderr,"E* Unable to parse argument for -v parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 't':
+				paramidx++;
+				if (paramidx == (argc-0)) { fprintf(stderr,"E* Too few arguments for -t parameter!\n"); usage(); exit(1); }
+				if (!strcmp(argv[paramidx], "ipa")) target = TARGET_IPA;
+				else if (!strcmp(argv[paramidx], "votrax")) target = TARGET_VOTRAX;
+				else if (!strcmp(argv[paramidx], "ascii")) target = TARGET_ASCII;
+				else if (!strcmp(argv[paramidx], "ids")) target = TARGET_IDS;
+				else { fprintf(stderr,"E* Unknown notation %s for -t parameter!\n", argv[paramidx]); usage(); exit(1); }
+				paramidx++;
+				break;
+			default:
+				{ fprintf(stderr,"E* Invalid option!\n"); usage(); exit(1); }
+				break;
+		}
+	}
+
+	c.ids = (target == TARGET_IDS);
+
+	// split up and compile every rule once, before any matching happens
+	initFeatures();
+	initIpaIndex();
+	ipa_stage ipa;
+	if (!compileRuleset(ruleset, RULES_TOTAL) || !compileRuleset(ipa_ruleset, RULES_IPA_TOTAL)
+		|| !compileIpaIds(ruleset, RULES_TOTAL) || !compileAsciiCodes(ipa_ruleset, RULES_IPA_TOTAL)
+		|| !ipaStageInit(&ipa, ipa_ruleset, target == TARGET_ASCII))
+	{
+		freeRuleset(ruleset, RULES_TOTAL);
+		freeRuleset(ipa_ruleset, RULES_IPA_TOTAL);
+		return 1;
+	}
+
 // input file
 	FILE *in = fopen(argv[1], "rb");
 	if (!in)
@@ -978,7 +1885,7 @@ int main(int argc, char **argv)
 			dataArray = NULL;
 			return 1;
 		}
-		fprintf(stderr,"D* Successfully read in %d bytes\n", temp); fflush(stderr);
+		e_printf(V_0,"D* Successfully read in %d bytes\n", temp);
 	}
 
 /*
@@ -997,48 +1904,80 @@ int main(int argc, char **argv)
 	// actual program goes here
 
 	// allocate a vector
-	vec_char32* d_in = vec_char32_alloc(4);
-
-	// read contents of dataArray into vec_char32
-	for (u32 i = 0; i < len; i++)
+	// wrap the input array as a vector, without copying it
+	vec_u8* d_in = malloc(sizeof(vec_u8));
+	d_in->elements = len;
+	d_in->capacity = len;
+	d_in->data = dataArray;
+	d_in->pool = NULL;
+	dataArray = NULL; // now owned by d_in
+	if (V_0)
 	{
-		vec_char32_append(d_in,dataArray[i]);
+		e_printf(V_DEBUG,"Input phrase stats are:\n");
+		vec_u8_dbg_stats(d_in);
+		vec_u8_dbg_print(d_in);
 	}
-	e_printf(V_DEBUG,"Input phrase stats are:\n");
-	vec_char32_dbg_stats(d_in);
-	vec_char32_dbg_print(d_in);
 
-	// free the input array
-	free(dataArray);
-	dataArray = NULL;
+	// all of the buffers of a phrase are in the scratch arena, which is reset after each phrase
+	arena scratch;
+	if (!arenaInit(&scratch, 1<<12))
+	{
+		fprintf(stderr,"E* Failure to allocate memory for the scratch arena, aborting!\n"); fflush(stderr);
+		vec_u8_free(d_in);
+		freeRuleset(ruleset, RULES_TOTAL);
+		freeRuleset(ipa_ruleset, RULES_IPA_TOTAL);
+		return 1;
+	}
 
 	// we may have multiple phrases in the input file, so handle each one here sequentially.
 	bool done = false;
 	u32 phrase_offset = 0;
 	while (!done)
 	{
-		// allocate another vector for preprocessing
-		vec_char32* d_pre = vec_char32_alloc(4);
+		// a vector for preprocessing; every input character of the phrase becomes at most three, plus the leading and
+		// trailing spaces, so it never has to grow
+		const u8* const end = memchr(&d_in->data[phrase_offset], '#', d_in->elements - phrase_offset);
+		const u32 phrase_len = end ? (end - &d_in->data[phrase_offset]) + 1 : d_in->elements - phrase_offset;
+		vec_u8 d_pre;
+		vec_u8_init_arena(&d_pre, &scratch, (phrase_len * 3) + 2);
 		// preprocess d_in into d_pre
-		phrase_offset = preprocess(d_in, d_pre, phrase_offset);
-		e_printf(V_DEBUG,"Preprocessing done, stats are now:\n");
-		vec_char32_dbg_stats(d_pre);
-		vec_char32_dbg_print(d_pre);
-		e_printf(V_DEBUG,"Input phrase offset is now %d\n", phrase_offset);
+		phrase_offset = preprocess(d_in, &d_pre, phrase_offset);
+		if (V_0)
+		{
+			e_printf(V_DEBUG,"Preprocessing done, stats are now:\n");
+			vec_u8_dbg_stats(&d_pre);
+			vec_u8_dbg_print(&d_pre);
+			e_printf(V_DEBUG,"Input phrase offset is now %d\n", phrase_offset);
+		}
 
-		// do stuff with preprocessed phrase here
-		// i.e. the rest of the owl
-		processPhrase(ruleset, d_pre);
+		// translate the phrase and write out its phonemes
+		vec_u8 d_out;
+		vec_u8_init_arena(&d_out, &scratch, d_pre.elements * 4);
+		const bool staged = (target == TARGET_VOTRAX) || (target == TARGET_ASCII);
+		processPhrase(ruleset, &d_pre, &d_out, staged ? &ipa : NULL, c);
+		fwrite(d_out.data, sizeof(u8), d_out.elements, stdout);
+		fputc(c.ids ? IPA_ID_END : '\n', stdout);
+		if (V_0 && c.ids)
+		{
+			vec_u8 d_text;
+			vec_u8_init_arena(&d_text, &scratch, d_out.elements * 4 + 1);
+			formatIpaIds(d_out.data, d_out.elements, &d_text);
+			e_printf(V_DEBUG,"IPA phoneme IDs as text:\n");
+			vec_u8_dbg_print(&d_text);
+		}
 
-		vec_char32_free(d_pre);
+		arenaReset(&scratch);
 		if (phrase_offset >= d_in->elements)
 		{
 			done = true;
 		}
-		// HACK: for now, just end after the first phrase; later we need to make sure CR/LF etc get nuked properly;
-		done = true;
 	}
-	vec_char32_free(d_in);
+	e_printf(V_0,"D* Scratch arena grew to %d bytes\n", scratch.size);
+	arenaFree(&scratch);
+	vec_u8_free(d_in);
+	freeRuleset(ruleset, RULES_TOTAL);
+	freeRuleset(ipa_ruleset, RULES_IPA_TOTAL);
+	fflush(stdout);
 
 	//fprintf(stdout,"trying to print size of arule array, should be 33\n");
 	//fprintf(stdout,"sizeof(arule_eng): %d\n", sizeof(arule_eng));
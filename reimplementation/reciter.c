@@ -2,13 +2,64 @@
 // copyright-holders:Jonathan Gevaryahu
 // Reimplementation of the Don't Ask Computer Software/Softvoice 'reciter'/'translator' engine
 // Copyright (C)2021-2024 Jonathan Gevaryahu
+// the POSIX declarations of the system headers (mmap, read, fileno, clock_gettime...), which a strict C11 build hides
+#ifndef _POSIX_C_SOURCE
+#define _POSIX_C_SOURCE 200809L
+#endif
 #include <stdio.h>
 #include <stdint.h>
 #include <stdlib.h>
 #include <stdbool.h>
+#include <stdarg.h>
 #include <uchar.h>
 #include <ctype.h>
 #include <string.h>
+#include <time.h>
+#include "reciter.h"
+
+// memory map the input file instead of reading it into memory, and read streamed input with read(), where the POSIX
+// file APIs are available
+#if defined(__unix__) || defined(__APPLE__)
+#define USE_MMAP 1
+#endif
+#ifdef USE_MMAP
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <errno.h>
+#endif
+
+// translate the lines of the input on several threads in batch mode (-b), where POSIX threads are available
+#if defined(__unix__) || defined(__APPLE__)
+#define USE_THREADS 1
+#endif
+#ifdef USE_THREADS
+#include <pthread.h>
+#endif
+
+// time things with the monotonic wall clock where POSIX has it, otherwise with the processor time of clock()
+#if defined(_POSIX_TIMERS) && (_POSIX_TIMERS > 0) && defined(CLOCK_MONOTONIC)
+#define USE_MONOTONIC_CLOCK 1
+#endif
+
+// time the rule matching for the rule profile (-p) with the processor's time stamp counter where the compiler exposes it,
+// which is much cheaper to read than the system clock
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define USE_RDTSC 1
+#include <x86intrin.h>
+#endif
+
+// compare the exact match part of each rule against the input with one SSE2 vector compare where the target has it
+#ifdef __SSE2__
+#define USE_SSE2 1
+#include <emmintrin.h>
+#endif
+// look up the character features of the input 16 characters at a time with SSSE3 byte shuffles where the target has them
+#ifdef __SSSE3__
+#define USE_SSSE3 1
+#include <tmmintrin.h>
+#endif
 
 // basic typedefs
 typedef int8_t s8;
@@ -24,6 +75,12 @@ typedef uint64_t u64;
 #define RULES_TOTAL 27
 #define RULES_PUNCT_DIGIT 26
 #define RECITER_END_CHAR 0x1b
+// number of zeroed bytes kept past the end of an input phrase, so the matchers can read a little past its end
+#define RECITER_PAD 16
+// nominal number of input bytes translated at a time
+#ifndef RECITER_CHUNK
+#define RECITER_CHUNK (1<<20)
+#endif
 
 #define SUPPORT_CONS1M 1
 #define SUPPORT_CONS1EI 1
@@ -55,63 +112,158 @@ typedef uint64_t u64;
 // 15. The version used in FL-Studio on Windows 7
 // There's also at least one bug caused by a transcription error from the IEEE paper in one rule.
 
-#define RULES_VERSION RULES_MACINTALK
+// All of the ruleset versions above which are implemented are built into the binary (see reciter_rules.h);
+// this selects which one is used when no ruleset is specified on the command line.
+#define RULES_DEFAULT RULES_MACINTALK
 
-// this will add the commodore specific rules that might not appear in some rule versions anyway.
-#define C64_ADDED_RULES 1
 // this will add the bugs from the commodore specific ruleset if rule version 3 is requested
 #undef C64_RULES_BUGS
 // this will add the bugs from the apple specific ruleset if rule version 2 is requested
 #undef APPLE_RULES_BUGS
-// this will fix the IEEE transcription error (missing the first '^' in "^[OU]^L=AH5") in versions which had the error
-#define FIX_IEEE_ERROR 1
 
+// Optional rule switches; every combination of these is built into the binary for every ruleset version, and they can be
+// toggled at runtime with the -r parameter.
+// this will add the commodore specific rules that might not appear in some rule versions anyway.
+#define RF_C64_ADDED_RULES 0x01
+// this will fix the IEEE transcription error (missing the first '^' in "^[OU]^L=AH5") in versions which had the error
+#define RF_FIX_IEEE_ERROR 0x02
 // this will add an additional rule to fix the words 'juice', 'juicy', 'juicier' and 'sluice' etc where the i needs to be silent
-#define NEW_RULE_UIC 1
+#define RF_NEW_RULE_UIC 0x04
+#define RF_ALL (RF_C64_ADDED_RULES|RF_FIX_IEEE_ERROR|RF_NEW_RULE_UIC)
+// the rule switches which are used when none are specified on the command line
+#define RULES_FLAGS_DEFAULT (RF_C64_ADDED_RULES|RF_FIX_IEEE_ERROR|RF_NEW_RULE_UIC)
+
+// release configuration: build with RECITER_RELEASE defined for a program which prints nothing but the translation by
+// default, with the tracing of the translation compiled out
+//#define RECITER_RELEASE 1
+
+#if defined(__GNUC__) || defined(__clang__)
+#define UNLIKELY(x) __builtin_expect(!!(x), 0)
+#else
+#define UNLIKELY(x) (x)
+#endif
+
+// everything but the reciter_* library interface is internal to the library build, so its names can't clash with those
+// of the program it is linked into; not all of it is used there, which is fine
+#ifdef RECITER_NO_MAIN
+#if defined(__GNUC__) || defined(__clang__)
+#define INTERNAL static __attribute__((unused))
+#else
+#define INTERNAL static
+#endif
+#else
+#define INTERNAL
+#endif
 
 // verbose macros
+// e_printf is for messages which should show up right away, and writes out any buffered trace output first, so the
+// two stay in order. t_printf is for tracing the translation while it happens, which can print several lines per rule
+// tried, so it goes through a buffer which is only written out when it fills up, rather than flushing every line.
 #define e_printf(v, ...) \
-	do { if (v) { fprintf(stderr, __VA_ARGS__); fflush(stderr); } } while (0)
+	do { if (v) { traceFlush(); fprintf(stderr, __VA_ARGS__); fflush(stderr); } } while (0)
+#define t_printf(v, ...) \
+	do { if (UNLIKELY(v)) { traceWrite(__VA_ARGS__); } } while (0)
 #define o_printf(v, ...) \
 	do { if (v) { fprintf(stdout, __VA_ARGS__); fflush(stdout); } } while (0)
 
+// the verbosity bits which trace the translation while it happens
+#define V_TRACE_BITS ((1<<2)|(1<<3)|(1<<4)|(1<<5)|(1<<6))
+// the trace bits which are compiled in; the others are always off, so their t_printf calls compile to nothing
+#ifndef RECITER_TRACE_MASK
+#ifdef RECITER_RELEASE
+#define RECITER_TRACE_MASK 0
+#else
+#define RECITER_TRACE_MASK V_TRACE_BITS
+#endif
+#endif
+
 // verbosity defines; V_DEBUG can be changed here to enable/disable debug messages
 #define V_DEBUG (1)
 #define V_ERR (1)
+// the details of an error found while translating (a bad rule, input no rule matches...); only the program prints these,
+// the library just returns the reciter_status of the error
+#define V_XLATE_ERR (c.report_errors)
 #define V_PARAM    (c.verbose & (1<<0))
 #define V_PARSE    (c.verbose & (1<<1))
-#define V_MAINLOOP (c.verbose & (1<<2))
-#define V_SEARCH   (c.verbose & (1<<3))
-#define V_SEARCH2  (c.verbose & (1<<4))
-#define V_RULES    (c.verbose & (1<<5))
-#define V_ERULES   (c.verbose & (1<<6))
+#define V_MAINLOOP (c.verbose & (1<<2) & RECITER_TRACE_MASK)
+#define V_SEARCH   (c.verbose & (1<<3) & RECITER_TRACE_MASK)
+#define V_SEARCH2  (c.verbose & (1<<4) & RECITER_TRACE_MASK)
+#define V_RULES    (c.verbose & (1<<5) & RECITER_TRACE_MASK)
+#define V_ERULES   (c.verbose & (1<<6) & RECITER_TRACE_MASK)
+#define V_STATS    (c.verbose & (1<<7))
+#define V_ECHO     (c.verbose & (1<<8))
+
+// trace output buffer. tracing is only done by one thread at a time: batch mode turns it off when it runs several
+#define TRACE_BUFFER_SIZE 65536
+static char trace_buf[TRACE_BUFFER_SIZE];
+static size_t trace_len = 0;
+
+INTERNAL void traceFlush()
+{
+	if (!trace_len) return;
+	fwrite(trace_buf, sizeof(char), trace_len, stderr);
+	fflush(stderr);
+	trace_len = 0;
+}
+
+INTERNAL void traceWrite(const char* format, ...)
+{
+	va_list args;
+	va_start(args, format);
+	const int n = vsnprintf(&trace_buf[trace_len], TRACE_BUFFER_SIZE - trace_len, format, args);
+	va_end(args);
+	if (n < 0) return;
+	if (trace_len + n < TRACE_BUFFER_SIZE)
+	{
+		trace_len += n;
+		return;
+	}
+	// it didn't fit, so write out the buffer and format it again into the empty buffer, or straight to stderr if it's
+	// too long for that
+	traceFlush();
+	va_start(args, format);
+	if (n < TRACE_BUFFER_SIZE) trace_len = vsnprintf(trace_buf, TRACE_BUFFER_SIZE, format, args);
+	else vfprintf(stderr, format, args);
+	va_end(args);
+}
 
 // 'vector' structs for holding data
 
-typedef struct vec_char32
+typedef struct vec_u8
 {
 	u32 elements; // number of elements in the vector, defaults to zero/empty
 	u32 capacity; // amount of element-sized memory blocks currently allocated for the vector; i.e. capacity
-	char32_t* data;
-} vec_char32;
+	u8* data;
+	bool borrowed; // data belongs to someone else (e.g. a caller's buffer), so the vector can't grow or free it
+} vec_u8;
 
-vec_char32* vec_char32_alloc(u32 init_len)
+INTERNAL vec_u8* vec_u8_alloc(u32 init_len)
 {
 	// allocate and initialize the vector
-	vec_char32 *r = malloc(sizeof(vec_char32));
+	vec_u8 *r = malloc(sizeof(vec_u8));
 	r->elements = 0;
 	r->capacity = 0;
-	// allocate the data pointer, and since the data is a direct type, this allocation contains the data itself
-	r->data = malloc(init_len * sizeof(char32_t));
+	r->borrowed = false;
+	r->data = malloc(init_len * sizeof(u8));
 	// fill in the capacity; if malloc failed (or init_len was zero), capacity remains 0 and the data pointer is NULL
 	if (r->data) r->capacity = init_len;
 	return r;
 }
 
-void vec_char32_free(vec_char32* l)
+INTERNAL void vec_u8_resize(vec_u8* l, u32 capacity)
+{
+	u8* new_data = realloc(l->data, sizeof(l->data[0]) * capacity);
+	if (new_data) // make sure it actually allocated...
+	{
+		l->capacity = capacity; // update to the new capacity
+		l->data = new_data; // update the stale pointer to the new data
+	}
+}
+
+INTERNAL void vec_u8_free(vec_u8* l)
 {
 	// free the data pointer itself
-	free(l->data);
+	if (!l->borrowed) free(l->data);
 	l->data = NULL;
 	l->capacity = 0;
 	l->elements = 0;
@@ -119,55 +271,286 @@ void vec_char32_free(vec_char32* l)
 	free(l);
 }
 
-void vec_char32_resize(vec_char32* l, u32 capacity)
-{
-	char32_t* new_data = realloc(l->data, sizeof(l->data[0]) * capacity);
-	if (new_data) // make sure it actually allocated...
-	{
-		l->capacity = capacity; // update to the new capacity
-		l->data = new_data; // update the stale pointer to the new data
-	}
-}
-
-void vec_char32_append(vec_char32* l, char32_t a)
+// returns false if the element couldn't be added, i.e. the vector is borrowed and full, or can't grow any more
+INTERNAL bool vec_u8_append(vec_u8* l, u8 a)
 {
 	// if current vector capacity is insufficient to have another element added to it, reallocate it to twice its current capacity
 	if (l->elements == l->capacity)
 	{
+		if (l->borrowed) return false;
 		u32 old_capacity = l->capacity;
-		u64 new_capacity = l->capacity<<1;
+		u64 new_capacity = old_capacity ? (u64)old_capacity<<1 : 16;
 		if ((new_capacity > ((u32)~0)) && (old_capacity <= ((u32)~0))) new_capacity = ((u32)~0); // if we would have exceeded a u32 but there's still headroom, realloc to max possible u32 size
-		vec_char32_resize(l, new_capacity);
-		if (l->capacity == old_capacity) return; // unable to resize properly, just bail out instead of doing bad things
+		vec_u8_resize(l, new_capacity);
+		if (l->capacity == old_capacity) return false; // unable to resize properly, just bail out instead of doing bad things
 	}
 	// stick the new element on the end of the list and update the number of elements
 	l->data[l->elements] = a;
 	l->elements++;
+	return true;
 }
 
-void vec_char32_dbg_stats(vec_char32* l)
+// appends n elements with one copy; returns false if they couldn't all be added, in which case as many as fit in a
+// borrowed vector were
+INTERNAL bool vec_u8_append_n(vec_u8* l, const u8* a, u32 n)
 {
-	e_printf(V_DEBUG,"vec_char32 capacity: %d, elements: %d\n", l->capacity, l->elements);
+	if (l->capacity - l->elements < n)
+	{
+		if (l->borrowed)
+		{
+			memcpy(&l->data[l->elements], a, l->capacity - l->elements);
+			l->elements = l->capacity;
+			return false;
+		}
+		const u64 need = (u64)l->elements + n;
+		u64 new_capacity = l->capacity ? (u64)l->capacity<<1 : 16;
+		if (new_capacity < need) new_capacity = need;
+		if (new_capacity > ((u32)~0)) new_capacity = ((u32)~0);
+		if (new_capacity < need) return false;
+		vec_u8_resize(l, new_capacity);
+		if (l->capacity != new_capacity) return false;
+	}
+	memcpy(&l->data[l->elements], a, n);
+	l->elements += n;
+	return true;
 }
 
-void vec_char32_dbg_print(vec_char32* l)
+INTERNAL void vec_u8_dbg_stats(vec_u8* l)
 {
-	e_printf(V_DEBUG,"vec_char32 contents: '");
-	for (u32 i=0; i < l->elements; i++)
-	{
-		e_printf(V_DEBUG,"%c", (char)l->data[i]);
-	}
+	e_printf(V_DEBUG,"vec_u8 capacity: %d, elements: %d\n", l->capacity, l->elements);
+}
+
+INTERNAL void vec_u8_dbg_print(vec_u8* l)
+{
+	if (!V_DEBUG) return;
+	e_printf(V_DEBUG,"vec_u8 contents: '");
+	fwrite(l->data, sizeof(uint8_t), l->elements, stderr);
 	e_printf(V_DEBUG,"'\n");
 }
 
+// maximum number of phoneme IDs in the right hand side of a rule
+#define RULE_IDS_MAX 32
+
+// compiled rule struct, holds a rule string pre-split into its four sections so the matcher never has to scan for the '[', ']' and '='
+// all of the section pointers point into the original (constant) rule string, so no rule text is copied
+typedef struct sym_rule
+{
+	const char* text; // the whole original rule string, for verbose printing
+	const char* prefix; // context left of the '[', matched right to left
+	const char* match; // exact match part between the '[' and ']'
+	const char* suffix; // context right of the ']', matched left to right
+	const char* output; // right hand side past the '='
+	u8 prefix_len;
+	u8 match_len;
+	u8 suffix_len;
+	u8 output_len;
+	u16 match_mask; // one bit for each of the first 16 characters of the exact match part
+	u8 match_pad[16]; // the first 16 characters of the exact match part, padded with zeroes
+	u8 output_ids_len;
+	u8 output_ids[RULE_IDS_MAX]; // the right hand side as phoneme IDs, see tokenizePhonemes
+} sym_rule;
+
+// dispatch index for one rule list, which narrows the rules to try down by the first two input characters at the match
+// position. rules are grouped by the first character of their exact match part, and each group is split into buckets by
+// the second character; rules with a one character exact match part are in every bucket of their group.
+typedef struct sym_index
+{
+	u8 group[0x80]; // 1-based group number for each first input character (&0x7f), 0 if no rule can match it
+	const u16* base; // per group, number of its first bucket; all of the index arrays share one allocation starting here
+	const u16* bucket; // per bucket, offset into cand of its first candidate, plus one entry for the end of the last bucket
+	const u16* cand; // candidate rule numbers, in rule order within each bucket
+	const u8* cls; // per group, 0x80 entries mapping the second input character (&0x7f) to a bucket within the group
+} sym_index;
+
+// rule automaton: the alternative to the interpretive matcher in processRule, which matches a whole rule list in one pass.
+// each rule is compiled into two small programs of dfa_op, one for the exact match part plus the suffix, which is run
+// left to right from the match position, and one for the prefix, which is run right to left from just before it. the
+// rule programs of a list are run in lockstep over the input, and the sets of rule program states are turned into
+// deterministic automaton states lazily, as they are reached. each side yields the set of rules it accepted, and the
+// lowest numbered rule accepted by both sides is the first matching rule.
+typedef struct dfa_op
+{
+	u8 kind; // DFA_OP_*
+	u8 ch; // character for DFA_OP_LIT
+	u16 test; // DFA_T_* character test for DFA_OP_TEST, DFA_OP_STAR and DFA_OP_PLUS
+} dfa_op;
+
+// input character class; all of the characters in a class behave identically for every rule program of the list
+typedef struct dfa_class
+{
+	u16 tests; // DFA_T_* tests the characters in this class pass
+	u8 ch; // the character, if it is one which rules compare against directly, otherwise 0
+} dfa_class;
+
+typedef struct dfa_trans
+{
+	s32 next; // next state, 0 for the dead state or -1 if the transition hasn't been built yet
+	s32 acc; // set of rules accepted on this transition, or -1 for none
+} dfa_trans;
+
+// one side (prefix, or exact match plus suffix) of a rule list automaton
+typedef struct dfa_side
+{
+	bool left; // runs right to left over the prefix
+	dfa_op* ops; // rule programs
+	u32* op_start; // per rule, offset of its program in ops, plus one entry for the end of the last program
+	s32 init_acc; // set of rules which accept before reading any input, or -1 for none
+	s32 start; // start state
+	u32 num_states;
+	u32 cap_states;
+	u32* state_pos; // per state, offset of its rule program states in threads, plus one entry for the end of the last state
+	u32* threads; // rule program states of every automaton state, each packed as rule<<18 | op<<8 | sub
+	u32 threads_size;
+	u32 threads_cap;
+	dfa_trans* trans; // num_states * num_symbols transitions
+	u32* state_hash; // open addressed hash of state number+1, for finding existing states
+	u32 state_hash_size;
+} dfa_side;
+
+// automaton for one rule list; built on its first use by matchRuleDfa()
+typedef struct sym_dfa
+{
+	bool built;
+	bool ok; // false if the list uses a rule symbol the automaton can't express, so the interpretive matcher is used instead
+	bool mactalk_symbols; // the list uses the '?' or '_' rule symbols, which only exist in RULES_MACTALK and later
+	u32 num_rules;
+	u32 words; // number of u64 in a set of rules
+	u32 num_classes;
+	u32 num_symbols; // num_classes, again for characters at the edge of the input, plus one for the end of the input
+	u8 cmap[0x100]; // class of each input byte
+	dfa_class cinfo[0x100];
+	u64* accs; // sets of accepted rules
+	u32 num_accs;
+	u32 cap_accs;
+	u32* acc_hash;
+	u32 acc_hash_size;
+	u32* scratch; // num_rules entries
+	u64* acc_scratch; // 3 sets
+	dfa_side side[2]; // [0] is the exact match part plus the suffix, [1] is the prefix
+} sym_dfa;
+
 // ruleset struct to point to all the rulesets for each letter/punct/etc
 typedef struct sym_ruleset
 {
 	u32 num_rules;
 	//u32* const * ruleLen;
-	const char* const * rule;
+	const char* const * rule; // static rule strings, only set in the static tables
+	const sym_rule* const * crule; // compiled versions of the rules, filled in by initRuleLibrary() for each runtime ruleset variant
+	const sym_index* index; // dispatch index for crule, filled in by initRuleLibrary() for each runtime ruleset variant
+	sym_dfa* dfa; // automaton for crule, owned by whoever uses the ruleset (see rule_tables) and built on first use
+	u32 symbol; // which rule table this is (0-25 for the letters, or RULES_PUNCT_DIGIT), for statistics
 } sym_ruleset;
 
+// rule string prefixes for the rules which only exist with (RULE_IF) or without (RULE_IFNOT) one of the RF_* rule switches
+// the prefix byte holds the RF_* bit, plus 0x10 for RULE_IFNOT; being a control character it can never start a real rule
+#define RULE_TAG_C64_ADDED_RULES "\x01"
+#define RULE_TAG_FIX_IEEE_ERROR "\x02"
+#define RULE_TAG_NEW_RULE_UIC "\x04"
+#define RULE_TAG_NOT_FIX_IEEE_ERROR "\x12"
+#define RULE_IF(f) RULE_TAG_##f
+#define RULE_IFNOT(f) RULE_TAG_NOT_##f
+#define RULE_TAG_NOT 0x10
+#define RULE_TAG_MAX 0x1f
+
+// instantiate the static rule tables for every ruleset version
+#define RULES_VERSION RULES_ATARI
+#define RULES_NAME(x) x##_atari
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_C64
+#define RULES_NAME(x) x##_c64
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_APPLE
+#define RULES_NAME(x) x##_apple
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_MACTALK
+#define RULES_NAME(x) x##_mactalk
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_MACINTALKDEMO
+#define RULES_NAME(x) x##_macintalkdemo
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_MACINTALK
+#define RULES_NAME(x) x##_macintalk
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+#define RULES_VERSION RULES_TRANSLATOR
+#define RULES_NAME(x) x##_translator
+#include "reciter_rules.h"
+#undef RULES_NAME
+#undef RULES_VERSION
+
+// table of every built in ruleset version, selectable at runtime by name
+typedef struct rule_variant
+{
+	const char* name;
+	u32 version; // RULES_* version number
+	const sym_ruleset* rules; // RULES_TOTAL static rule tables
+} rule_variant;
+
+static const rule_variant rule_variants[] =
+{
+	{ "atari", RULES_ATARI, ruleset_atari },
+	{ "c64", RULES_C64, ruleset_c64 },
+	{ "apple", RULES_APPLE, ruleset_apple },
+	{ "mactalk", RULES_MACTALK, ruleset_mactalk },
+	{ "macintalkdemo", RULES_MACINTALKDEMO, ruleset_macintalkdemo },
+	{ "macintalk", RULES_MACINTALK, ruleset_macintalk },
+	{ "translator", RULES_TRANSLATOR, ruleset_translator },
+};
+#define NUM_RULE_VARIANTS (sizeof(rule_variants)/sizeof(*rule_variants))
+// every ruleset version is available with every combination of rule switches
+#define NUM_RULE_HANDLES (NUM_RULE_VARIANTS*(RF_ALL+1))
+
+// names of the rule switches, in RF_* bit order, for the -r parameter
+static const char* const rule_flag_names[] = { "c64added", "fixieee", "uic" };
+#define NUM_RULE_FLAGS (sizeof(rule_flag_names)/sizeof(*rule_flag_names))
+
+// find the index of a built in ruleset version by name, returns -1 if there is no such version
+INTERNAL s32 findRuleVersion(const char* name, size_t len)
+{
+	for (u32 i = 0; i < NUM_RULE_VARIANTS; i++)
+	{
+		if ((strlen(rule_variants[i].name) == len) && (!strncmp(rule_variants[i].name, name, len))) return rule_variants[i].version;
+	}
+	return -1;
+}
+
+// parse a ruleset specification of the form "name[,+switch][,-switch]...", e.g. "atari,-uic,+fixieee".
+// switches which are not mentioned keep the values they had in *flags on entry. returns false if the specification is invalid.
+INTERNAL bool parseRuleSpec(const char* spec, u32* version, u32* flags)
+{
+	const char* comma = strchr(spec, ',');
+	s32 v = findRuleVersion(spec, comma ? (size_t)(comma - spec) : strlen(spec));
+	if (v < 0) return false;
+	*version = v;
+	while (comma)
+	{
+		const char* sw = comma+1;
+		comma = strchr(sw, ',');
+		size_t len = comma ? (size_t)(comma - sw) : strlen(sw);
+		if ((len < 2) || ((sw[0] != '+') && (sw[0] != '-'))) return false;
+		u32 i;
+		for (i = 0; i < NUM_RULE_FLAGS; i++)
+		{
+			if ((strlen(rule_flag_names[i]) == len-1) && (!strncmp(rule_flag_names[i], sw+1, len-1))) break;
+		}
+		if (i == NUM_RULE_FLAGS) return false;
+		if (sw[0] == '+') *flags |= (1<<i);
+		else *flags &= ~(1<<i);
+	}
+	return true;
+}
+
 // Digits, 0-9
 #define A_DIGIT 0x01
 // Punctuation characters that do not end a word "!\"#$%\'*+,-./0123456789:;<=>?@^"
@@ -189,23 +572,58 @@ typedef struct sym_ruleset
 // + Front vowel is handled in the code itself
 // % Suffix is handled in the code itself
 
+// matcher statistics
+typedef struct s_stats
+{
+	u64 lookups[RULES_TOTAL]; // number of times a rule table was searched
+	u64 tried[RULES_TOTAL]; // number of rules tried while searching each rule table
+	u64 dfa_fallbacks; // number of searches the automaton couldn't do, which used the interpretive matcher instead
+	u64 mismatches; // number of searches where the automaton and the interpretive matcher disagreed, for MATCHER_CHECK
+	u64 cache_hits; // number of words whose translation was found in the word cache
+	u64 cache_misses; // number of words which were translated and added to the word cache
+	u64 input_bytes; // number of bytes of input translated
+	u64 output_bytes; // number of bytes of output written by an output_writer
+	u64 output_writes; // number of writes (i.e. system calls) the output_writer made for them
+} s_stats;
+
+typedef struct word_cache word_cache;
+typedef struct rule_profile rule_profile;
+typedef struct rule_log rule_log;
+
+// rule matchers
+#define MATCHER_INTERP 0 // interpretive matcher, tries the rules in turn
+#define MATCHER_DFA 1 // rule list automaton
+#define MATCHER_CHECK 2 // run both and compare them, using the interpretive matcher's result
+#define NUM_MATCHERS 3
+INTERNAL const char* const matcher_names[NUM_MATCHERS] = { "interp", "dfa", "check" };
+
 // 'global' struct
 typedef struct s_cfg
 {
 	const u8 const ascii_features[0x80];
 	//sym_ruleset rules[RULES_TOTAL];
 	u32 verbose;
+	u32 rules_version; // RULES_* version of the selected ruleset, for the rule symbols which only exist in later versions
+	bool use_index; // use the rule dispatch index instead of trying every rule of a table in turn
+	u32 matcher; // MATCHER_*
+	s_stats* stats;
+	word_cache* cache; // translations of recently seen words, if not NULL
+	rule_profile* profile; // per rule counters, if not NULL
+	rule_log* used_rules; // log of the rules used, if not NULL
+	vec_u8* features; // feature bytes of the input being translated, parallel to it, filled in by classifyInput()
+	bool phoneme_ids; // the output is phoneme IDs (see tokenizePhonemes) rather than text
+	bool report_errors; // print the details of errors found while translating, see V_XLATE_ERR
 } s_cfg;
 
 //NRL isIllegalPunct: "[]\/"
 // probably SV equivalent is `return (ascii_features[in&0x7f]==0);`
 
-bool isDigit(char32_t in, s_cfg c)
+INTERNAL bool isDigit(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_DIGIT;
 }
 
-bool isPunct(char32_t in, s_cfg c)
+INTERNAL bool isPunct(char32_t in, s_cfg c)
 {
 	// NRL: " ,.?;:+*"$%&-<>!()='"
 	// SV: "!\"#$%\'*+,-./0123456789:;<=>?@^"
@@ -214,57 +632,107 @@ bool isPunct(char32_t in, s_cfg c)
 
 //NRL isPunctNoSpace: return (isPunct(in)&& (in != ' '))
 
-bool isUaff(char32_t in, s_cfg c)
+INTERNAL bool isUaff(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_UAFF;
 }
 
-bool isVoiced(char32_t in, s_cfg c)
+INTERNAL bool isVoiced(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_VOICED;
 }
 
-bool isSibil(char32_t in, s_cfg c)
+INTERNAL bool isSibil(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_SIBIL;
 }
 
-bool isCons(char32_t in, s_cfg c)
+INTERNAL bool isCons(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_CONS;
 }
 
-bool isVowel(char32_t in, s_cfg c)
+INTERNAL bool isVowel(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_VOWEL;
 }
 
-bool isLetter(char32_t in, s_cfg c)
+INTERNAL bool isLetter(char32_t in, s_cfg c)
 {
 	return c.ascii_features[in&0x7f]&A_LETTER;
 }
 
-bool isFront(char32_t in, s_cfg c)
+INTERNAL bool isFront(char32_t in, s_cfg c)
 {
 	in = toupper(in);
 	return ((in == 'E')||(in == 'I')||(in == 'Y'));
 }
 
-// preprocess: add a leading space, and turn all characters from lowercase into capital letters.
-void preProcess(vec_char32* in, vec_char32* out, s_cfg c)
+// preprocess in place: add a leading space, and turn all characters from lowercase into capital letters.
+// the raw input is expected at data[1] onward with data[0] left free for the space, and the vector needs room for the
+// terminating character plus RECITER_PAD bytes past the end of the input.
+INTERNAL void preProcess(vec_u8* phrase, s_cfg c)
 {
-	// prepend a space to output
-	vec_char32_append(out, ' ');
+	// prepend a space
+	phrase->data[0] = ' ';
 	// iterate over input
-	for (u32 i = 0; i < in->elements; i++)
+	for (u32 i = 1; i < phrase->elements; i++)
 	{
-		vec_char32_append(out, toupper(in->data[i]));
+		phrase->data[i] = toupper(phrase->data[i]);
 	}
 	// reached end of input, add a terminating character (usually 0x1b, ESC)
-	vec_char32_append(out, RECITER_END_CHAR);
+	phrase->data[phrase->elements++] = RECITER_END_CHAR;
+	// and clear the padding
+	memset(&phrase->data[phrase->elements], 0, RECITER_PAD);
+}
+
+// look up the feature byte of every character of the preprocessed input and of the RECITER_PAD bytes after it, into
+// features, so the matchers test a character class with one load from an array parallel to the input instead of a
+// lookup in the feature table for every test. returns false if features couldn't be made big enough.
+INTERNAL bool classifyInput(const vec_u8* const input, vec_u8* const features, s_cfg c)
+{
+	const u32 n = input->elements + RECITER_PAD;
+	if (n > features->capacity)
+	{
+		vec_u8_resize(features, n);
+		if (n > features->capacity) return false;
+	}
+	features->elements = input->elements;
+	const u8* const in = input->data;
+	u8* const out = features->data;
+	u32 i = 0;
+#ifdef USE_SSSE3
+	// each row of 16 entries of the table is one shuffle, indexed by the low 4 bits of the characters, and kept for the
+	// characters whose next 3 bits select that row; bytes past 0x7f have the features of their low 7 bits
+	__m128i rows[8];
+	for (u32 h = 0; h < 8; h++)
+	{
+		rows[h] = _mm_loadu_si128((const __m128i*)&c.ascii_features[h<<4]);
+	}
+	const __m128i low_bits = _mm_set1_epi8(0x0f);
+	const __m128i row_bits = _mm_set1_epi8(0x07);
+	for (; i + 16 <= n; i += 16)
+	{
+		const __m128i v = _mm_loadu_si128((const __m128i*)&in[i]);
+		const __m128i col = _mm_and_si128(v, low_bits);
+		const __m128i row = _mm_and_si128(_mm_srli_epi16(v, 4), row_bits);
+		__m128i f = _mm_setzero_si128();
+		for (u32 h = 0; h < 8; h++)
+		{
+			const __m128i sel = _mm_cmpeq_epi8(row, _mm_set1_epi8(h));
+			f = _mm_or_si128(f, _mm_and_si128(sel, _mm_shuffle_epi8(rows[h], col)));
+		}
+		_mm_storeu_si128((__m128i*)&out[i], f);
+	}
+#endif
+	for (; i < n; i++)
+	{
+		out[i] = c.ascii_features[in[i]&0x7f];
+	}
+	return true;
 }
 
-u32 getRuleNum(char32_t input)
+INTERNAL u32 getRuleNum(char32_t input)
 {
 	if (isdigit(input))
 	{
@@ -282,7 +750,7 @@ u32 getRuleNum(char32_t input)
 
 // returns the offset of the first instance of a character found in a string
 // starting from the left. otherwise return -1.
-s32 strnfind(const char *src, int c, size_t n)
+INTERNAL s32 strnfind(const char *src, int c, size_t n)
 {
 	for (int i = 0; i < n; i++)
 	{
@@ -320,351 +788,1443 @@ s32 strnfind(const char *src, int c, size_t n)
 #define LPAREN '['
 #define RPAREN ']'
 
-s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input, const u32 inpos, vec_char32* output, s_cfg c)
+// the phonemes of the rule right hand sides, in the order of SAM's phoneme tables; a '*' stands for no second
+// character. a phoneme ID is a byte: below PHONEME_ID_STRESS it is the index of a phoneme here, PHONEME_ID_STRESS+n is
+// stress digit n of the phoneme before it, and from 0x80 on it is any other character c of the output, as 0x80|c.
+static const char phoneme_names[][2] =
 {
-	// iterate through the rules
-	u32 i = 0;
-	for (i = 0; i < ruleset.num_rules; i++)
+	{' ','*'}, {'.','*'}, {'?','*'}, {',','*'}, {'-','*'}, {'I','Y'}, {'I','H'}, {'E','H'}, {'A','E'}, {'A','A'},
+	{'A','H'}, {'A','O'}, {'U','H'}, {'A','X'}, {'I','X'}, {'E','R'}, {'U','X'}, {'O','H'}, {'R','X'}, {'L','X'},
+	{'W','X'}, {'Y','X'}, {'W','H'}, {'R','*'}, {'L','*'}, {'W','*'}, {'Y','*'}, {'M','*'}, {'N','*'}, {'N','X'},
+	{'D','X'}, {'Q','*'}, {'S','*'}, {'S','H'}, {'F','*'}, {'T','H'}, {'/','H'}, {'/','X'}, {'Z','*'}, {'Z','H'},
+	{'V','*'}, {'D','H'}, {'C','H'}, {'J','*'}, {'E','Y'}, {'A','Y'}, {'O','Y'}, {'A','W'}, {'O','W'}, {'U','W'},
+	{'B','*'}, {'D','*'}, {'G','*'}, {'G','X'}, {'P','*'}, {'T','*'}, {'K','*'}, {'K','X'}, {'U','L'}, {'U','M'},
+	{'U','N'},
+};
+#define NUM_PHONEMES (sizeof(phoneme_names)/sizeof(*phoneme_names))
+#define PHONEME_ID_STRESS 0x40
+
+// split text into phoneme IDs the way SAM parses phonemes: a two character phoneme if there is one, otherwise a one
+// character phoneme, a stress digit, or any other character as it is. returns the number of IDs, or -1 if there
+// would be more than max of them.
+INTERNAL s32 tokenizePhonemes(const char* const text, const u32 len, u8* const ids, const u32 max)
+{
+	u32 n = 0;
+	for (u32 k = 0; k < len; k++)
 	{
-		e_printf(V_SEARCH, "found a rule %s\n", ruleset.rule[i]);
-		// part 1: check the exact match section of the rule, between the parentheses
-		// (and get the indexes to the two parentheses and the equals symbol, which will be used in parts 2 and 3)
-		s32 lparen_idx = -1;
-		s32 rparen_idx = -1;
-		s32 equals_idx = -1;
-		//u32 rulelen = -1;
-		/* slow but safe... */
-		/*
-		rulelen = strlen(ruleset.rule[i]);
-		lparen_idx = strnfind(ruleset.rule[i], LPAREN, rulelen);
-		rparen_idx = strnfind(ruleset.rule[i], RPAREN, rulelen);
-		equals_idx = strnfind(ruleset.rule[i], '=', rulelen);
-		e_printf(V_DEBUG, "  safe: left paren found at %d, right paren found at %d, equals found at %d, rulelen was %d\n", lparen_idx, rparen_idx, equals_idx, rulelen);
-		*/
-		/* faster but less safe... will run off the end of the rule string if a rule has no equals sign and doesn't end with a NULL '/0'
-		 (which should never happen) */
-		//lparen_idx = -1;
-		//rparen_idx = -1;
-		//equals_idx = -1;
-		/*for (rparen_idx = 0; ruleset.rule[i][rparen_idx] != RPAREN; rparen_idx++)
-		{
-			if (ruleset.rule[i][rparen_idx] == LPAREN)
-				lparen_idx = rparen_idx;
-		}*/
-		int j;
-		for (j = 0; (ruleset.rule[i][j] != '\0'); j++)
-		{
-			if (ruleset.rule[i][j] == LPAREN)
-				lparen_idx = j;
-			if (ruleset.rule[i][j] == RPAREN)
-				rparen_idx = j;
-			if (ruleset.rule[i][j] == '=')
-				equals_idx = j;
-		}
-		//rulelen = j;
-		//e_printf(V_DEBUG, "unsafe: left paren found at %d, right paren found at %d, equals found at %d, rulelen was %d\n", lparen_idx, rparen_idx, equals_idx, j);
-		int nbase = (rparen_idx - 1) - lparen_idx; // number of letters in exact match part of the rule
-		//e_printf(V_DEBUG, "n calculated to be %d\n", n);
+		if (n == max) return -1;
+		s32 id = -1;
+		for (u32 i = 0; (i < NUM_PHONEMES) && (id < 0) && (k + 1 < len); i++)
+		{
+			if ((phoneme_names[i][0] == text[k]) && (phoneme_names[i][1] == text[k+1])) id = i;
+		}
+		if (id >= 0)
+		{
+			ids[n++] = id;
+			k++;
+			continue;
+		}
+		for (u32 i = 0; (i < NUM_PHONEMES) && (id < 0); i++)
+		{
+			if ((phoneme_names[i][0] == text[k]) && (phoneme_names[i][1] == '*')) id = i;
+		}
+		if (id >= 0) ids[n++] = id;
+		else if ((text[k] >= '1') && (text[k] <= '8')) ids[n++] = PHONEME_ID_STRESS + (text[k] - '0');
+		else ids[n++] = 0x80 | text[k];
+	}
+	return n;
+}
 
-		// part1: compare exact match; basically a slightly customized 'strncmp()'
+// the phoneme ID of a single character of output, e.g. the space or period processPhrase emits between words
+INTERNAL u8 charPhonemeId(const char a)
+{
+	u8 id;
+	tokenizePhonemes(&a, 1, &id, 1);
+	return id;
+}
+
+// append the text of n phoneme IDs to out, which has to have room for two characters per ID; returns the number of
+// characters written
+INTERNAL u32 formatPhonemeIds(const u8* const ids, const u32 n, char* const out)
+{
+	char* o = out;
+	for (u32 k = 0; k < n; k++)
+	{
+		const u8 id = ids[k];
+		if (id < NUM_PHONEMES)
 		{
-			int n = nbase;
-			int offset = 0; // offset within rule of exact match
-			while ( n && (input->data[inpos+offset]) && (input->data[inpos+offset] == ruleset.rule[i][lparen_idx+1+offset]) )
+			*o++ = phoneme_names[id][0];
+			if (phoneme_names[id][1] != '*') *o++ = phoneme_names[id][1];
+		}
+		else if (id & 0x80) *o++ = id & 0x7f;
+		else *o++ = '0' + (id - PHONEME_ID_STRESS);
+	}
+	return o - out;
+}
+
+// split a rule string into its prefix, exact match, suffix and output sections.
+// returns false if the rule is malformed (missing '[', ']' or '=', or a section too long to fit in a u8)
+INTERNAL bool compileRule(const char* const rule, sym_rule* out)
+{
+	const char* lparen = strchr(rule, LPAREN);
+	if ((!lparen) || (lparen[1] == '\0')) return false;
+	// the exact match part is at least one character long, so a ']' right after the '[' is treated as a literal
+	const char* rparen = strchr(lparen+2, RPAREN);
+	if (!rparen) return false;
+	const char* equals = strchr(rparen+1, '=');
+	if (!equals) return false;
+	size_t output_len = strlen(equals+1);
+	if (((lparen - rule) > 0xff) || ((rparen - lparen - 1) > 0xff) || ((equals - rparen - 1) > 0xff) || (output_len > 0xff)) return false;
+	out->text = rule;
+	out->prefix = rule;
+	out->prefix_len = lparen - rule;
+	out->match = lparen+1;
+	out->match_len = rparen - lparen - 1;
+	out->suffix = rparen+1;
+	out->suffix_len = equals - rparen - 1;
+	out->output = equals+1;
+	out->output_len = output_len;
+	memset(out->match_pad, 0, sizeof(out->match_pad));
+	const u32 pad_len = (out->match_len < sizeof(out->match_pad)) ? out->match_len : sizeof(out->match_pad);
+	memcpy(out->match_pad, out->match, pad_len);
+	out->match_mask = (1U << pad_len) - 1;
+	const s32 ids_len = tokenizePhonemes(out->output, out->output_len, out->output_ids, RULE_IDS_MAX);
+	if (ids_len < 0) return false;
+	out->output_ids_len = ids_len;
+	return true;
+}
+
+// returns the tag byte of a static rule string (see RULE_IF), or 0 if the rule is not tagged
+INTERNAL u8 ruleTag(const char* const rule)
+{
+	return ((u8)rule[0] <= RULE_TAG_MAX) ? rule[0] : 0;
+}
+
+// returns true if a rule with the given tag byte is part of the ruleset with the given RF_* rule switches
+INTERNAL bool ruleTagSelected(const u8 tag, const u32 flags)
+{
+	if (!tag) return true;
+	if (tag & RULE_TAG_NOT) return !(flags & tag & RF_ALL);
+	return (flags & tag & RF_ALL);
+}
+
+// a compiled, ready to use ruleset variant, i.e. a ruleset version with one combination of rule switches.
+// handles for every variant are built once at startup by initRuleLibrary(), so picking a different variant for each
+// phrase costs nothing. a handle is never modified once it is built, so it can be shared between threads; the automata
+// of its rule lists are built as they are used, so they are not part of it (see rule_tables).
+typedef struct reciter_rules
+{
+	const rule_variant* variant;
+	u32 flags; // RF_* rule switches
+	sym_ruleset ruleset[RULES_TOTAL];
+} rule_handle;
+
+// compiled rule storage shared by every ruleset variant: each distinct rule string is compiled only once into pool,
+// and each distinct per-symbol list of rules is stored only once in lists, no matter how many variants use it
+typedef struct reciter_library
+{
+	sym_rule* pool;
+	u32 pool_size;
+	const sym_rule** lists;
+	u32 lists_size;
+	sym_index* indexes; // dispatch index of each distinct rule list
+	u32 num_refs; // number of rule references over all variants, before deduplication
+	u32 num_lists; // number of distinct rule lists
+	rule_handle handles[NUM_RULE_HANDLES];
+} rule_library;
+
+// FNV-1a hash, used for deduplicating the rule strings and rule lists
+INTERNAL u32 hashBytes(const void* data, size_t len)
+{
+	const u8* p = data;
+	u32 h = 0x811c9dc5;
+	for (size_t i = 0; i < len; i++)
+	{
+		h ^= p[i];
+		h *= 0x01000193;
+	}
+	return h;
+}
+
+// build the dispatch index for a rule list
+INTERNAL bool buildRuleIndex(const sym_rule* const * rules, const u32 num_rules, sym_index* idx)
+{
+	memset(idx, 0, sizeof(*idx));
+	// assign a group to each distinct first character
+	u32 ngroups = 0;
+	for (u32 i = 0; i < num_rules; i++)
+	{
+		u8 f = rules[i]->match[0]&0x7f;
+		if (!idx->group[f]) idx->group[f] = ++ngroups;
+	}
+	// within each group, assign a bucket class to each distinct second character; class 0 is every other character
+	u8* cls = calloc(ngroups ? ngroups : 1, 0x80);
+	u32* nclass = calloc(ngroups ? ngroups : 1, sizeof(u32));
+	bool ok = (cls && nclass);
+	for (u32 i = 0; ok && (i < num_rules); i++)
+	{
+		if (rules[i]->match_len < 2) continue;
+		u32 g = idx->group[rules[i]->match[0]&0x7f]-1;
+		u8 sc = rules[i]->match[1]&0x7f;
+		if (!cls[(g<<7)+sc]) cls[(g<<7)+sc] = ++nclass[g];
+	}
+	// count the buckets and the candidates; a one character rule is a candidate in every bucket of its group
+	u32 nbuckets = 0;
+	u32 ncand = 0;
+	for (u32 g = 0; ok && (g < ngroups); g++)
+	{
+		nbuckets += nclass[g]+1;
+	}
+	for (u32 i = 0; ok && (i < num_rules); i++)
+	{
+		u32 g = idx->group[rules[i]->match[0]&0x7f]-1;
+		ncand += (rules[i]->match_len < 2) ? nclass[g]+1 : 1;
+	}
+	if (ok && ((ncand > 0xffff) || (nbuckets >= 0xffff) || (num_rules > 0xffff))) ok = false;
+	u16* mem = NULL;
+	if (ok)
+	{
+		mem = malloc((ngroups + nbuckets+1 + ncand) * sizeof(u16) + (ngroups<<7));
+		ok = (mem != NULL);
+	}
+	if (ok)
+	{
+		u16* base = mem;
+		u16* bucket = base + ngroups;
+		u16* cand = bucket + nbuckets+1;
+		u8* cls_out = (u8*)(cand + ncand);
+		memcpy(cls_out, cls, ngroups<<7);
+		// fill in the buckets, in group and class order, each with its candidates in rule order
+		u32 b = 0;
+		u32 n = 0;
+		for (u32 g = 0; g < ngroups; g++)
+		{
+			base[g] = b;
+			for (u32 k = 0; k <= nclass[g]; k++)
 			{
-				//e_printf(V_DEBUG, "strncmp - attempting to match %c(%02x) to %c(%02x)\n",input->data[inpos+offset],input->data[inpos+offset],ruleset.rule[i][lparen_idx+1+offset],ruleset.rule[i][lparen_idx+1+offset] );
-				offset++;
-				n--;
+				bucket[b++] = n;
+				for (u32 i = 0; i < num_rules; i++)
+				{
+					const sym_rule* r = rules[i];
+					if (idx->group[r->match[0]&0x7f]-1 != g) continue;
+					if ((r->match_len < 2) || (cls[(g<<7)+(r->match[1]&0x7f)] == k)) cand[n++] = i;
+				}
 			}
-			/*
-			for (; n > 0; n--)
+		}
+		bucket[b] = n;
+		idx->base = base;
+		idx->bucket = bucket;
+		idx->cand = cand;
+		idx->cls = cls_out;
+	}
+	free(cls);
+	free(nclass);
+	return ok;
+}
+
+INTERNAL void freeRuleIndex(sym_index* idx)
+{
+	free((void*)idx->base);
+	memset(idx, 0, sizeof(*idx));
+}
+
+// rule automaton program operations
+#define DFA_OP_LIT 0 // one exact character
+#define DFA_OP_TEST 1 // one character passing a test
+#define DFA_OP_STAR 2 // zero or more characters passing a test (':' and '_')
+#define DFA_OP_PLUS 3 // one or more characters passing a test ('*')
+#define DFA_OP_CONS_PLUS 4 // the prefix '^:' pair, where the ':' leaves one consonant for the '^' to match
+#define DFA_OP_SIBIL 5 // '&', with the CH and SH cases
+#define DFA_OP_UAFF 6 // '@', with the TH, CH and SH cases
+#define DFA_OP_ENDING 7 // '%', the suffix only 'E', 'ER', 'ES', 'ED', 'ELY', 'EFUL' and 'ING'
+#define DFA_OP_CONS_EI 8 // '$', a consonant followed by 'E' or 'I'
+
+// character tests, these match the is*() functions
+#define DFA_T_LETTER 0x001
+#define DFA_T_NOTLETTER 0x002
+#define DFA_T_VOWEL 0x004
+#define DFA_T_VOICED 0x008
+#define DFA_T_CONS 0x010
+#define DFA_T_FRONT 0x020
+#define DFA_T_DIGIT 0x040
+#define DFA_T_SIBIL 0x080
+#define DFA_T_UAFF 0x100
+
+// result of feeding a character to a rule program
+#define DFA_FAIL 0
+#define DFA_LIVE 1
+#define DFA_ACCEPT 2
+
+#define DFA_MAX_STATES 0x4000
+#define DFA_MAX_RULES 0x3fff
+#define DFA_MAX_OPS 0x3ff
+
+// characters which some rule program operation compares against directly
+#define DFA_SPECIAL_CHARS "CDEFGHILNRSTUY"
+
+// compile one side of a rule into program operations; returns false if the rule uses a symbol the automaton can't express
+INTERNAL bool compileDfaSide(const char* text, const u32 len, const bool left, dfa_op* ops, u32* num_ops, bool* mactalk_symbols, s_cfg c)
+{
+#ifdef NRL_VOWEL
+	return false; // the NRL rule sides can split up the input in more than one way, see nrlMatchSide()
+#endif
+	u32 n = 0;
+	for (u32 k = 0; k < len; k++)
+	{
+		const char rulechar = left ? text[len-1-k] : text[k];
+		dfa_op o = { DFA_OP_TEST, 0, 0 };
+		if (isLetter(rulechar, c)) { o.kind = DFA_OP_LIT; o.ch = rulechar; }
+		else if (rulechar == ' ') o.test = DFA_T_NOTLETTER;
+		else if (rulechar == '#') o.test = DFA_T_VOWEL;
+		else if (rulechar == '.') o.test = DFA_T_VOICED;
+		else if (rulechar == '&') o.kind = DFA_OP_SIBIL;
+		else if (rulechar == '@') o.kind = DFA_OP_UAFF;
+		else if (rulechar == '^') o.test = DFA_T_CONS;
+		else if (rulechar == '+') o.test = DFA_T_FRONT;
+		else if (rulechar == ':')
+		{
+			o.test = DFA_T_CONS;
+			o.kind = DFA_OP_STAR;
+			if (left && (k+1 < len) && (text[len-2-k] == '^')) // '^:' case, see processRule
 			{
-				if (!input->data[inpos+offset])
+				o.kind = DFA_OP_CONS_PLUS;
+				k++;
+			}
+		}
+		else if ((rulechar == '%') && !left) o.kind = DFA_OP_ENDING;
+#ifdef SUPPORT_CONS1M
+		else if (rulechar == '*') { o.kind = DFA_OP_PLUS; o.test = DFA_T_CONS; }
+#endif
+#ifdef SUPPORT_CONS1EI
+		else if (rulechar == '$') o.kind = DFA_OP_CONS_EI;
+#endif
+		else if (rulechar == '?') { o.test = DFA_T_DIGIT; *mactalk_symbols = true; }
+		else if (rulechar == '_') { o.kind = DFA_OP_STAR; o.test = DFA_T_DIGIT; *mactalk_symbols = true; }
+		else return false; // invalid rule character; the interpretive matcher reports it
+		ops[n++] = o;
+	}
+	*num_ops = n;
+	return true;
+}
+
+// feed one input character class to a rule program state; edge is set for the last element of the input on the right
+// side and the first element on the left side, where the repeating operations stop consuming characters
+INTERNAL u32 dfaFeed(const sym_dfa* dfa, const dfa_side* side, u32* thread, const u32 cls, const bool edge)
+{
+	const u32 rule = *thread>>18;
+	const dfa_op* const prog = &side->ops[side->op_start[rule]];
+	const u32 num_ops = side->op_start[rule+1] - side->op_start[rule];
+	const dfa_class* const ci = &dfa->cinfo[cls];
+	u32 op = (*thread>>8)&0x3ff;
+	u32 sub = *thread&0xff;
+	// characters consumed while looking ahead which have to be fed again to the following operation, if the
+	// look-ahead didn't match
+	const char* replay = NULL;
+	while (1)
+	{
+		const char* lookahead = NULL;
+		if (op == num_ops) return DFA_ACCEPT;
+		if (replay && *replay)
+		{
+			*thread = (rule<<18)|(op<<8)|sub;
+			u32 r = dfaFeed(dfa, side, thread, dfa->cmap[(u8)*replay++], false);
+			if (r != DFA_LIVE) return r;
+			op = (*thread>>8)&0x3ff;
+			sub = *thread&0xff;
+			continue;
+		}
+		const dfa_op* const o = &prog[op];
+		const bool pass = (ci->tests & o->test);
+		bool consume = false; // consume the character and move to the next operation
+		bool skip = false; // move to the next operation and feed it the character
+		switch (o->kind)
+		{
+			case DFA_OP_LIT:
+				if (ci->ch != o->ch) return DFA_FAIL;
+				consume = true;
+				break;
+			case DFA_OP_TEST:
+				if (!pass) return DFA_FAIL;
+				consume = true;
+				break;
+			case DFA_OP_STAR:
+				if (pass && !edge) break;
+				skip = true;
+				break;
+			case DFA_OP_PLUS:
+				if ((!sub) && (!pass)) return DFA_FAIL;
+				if (pass && !edge) sub = 1;
+				else skip = true;
+				break;
+			case DFA_OP_CONS_PLUS:
+				if (!sub)
 				{
-					e_printf(V_DEBUG, "strncmp got null/end of string, bailing out!\n");
-					break;
+					if (!pass) return DFA_FAIL;
+					if (edge) consume = true; // the ':' can't take it, but the '^' can
+					else sub = 1;
+				}
+				else if (!(pass && !edge)) skip = true;
+				break;
+			case DFA_OP_SIBIL:
+				if (side->left)
+				{
+					if (!sub)
+					{
+						if (ci->tests & DFA_T_SIBIL) consume = true;
+						else if (ci->ch == 'H') sub = 1;
+						else return DFA_FAIL;
+					}
+					else if ((ci->ch == 'C') || (ci->ch == 'S')) consume = true;
+					else return DFA_FAIL;
 				}
 				else
 				{
-					e_printf(V_DEBUG, "strncmp - attempting to match %c(%02x) to %c(%02x)\n",input->data[inpos+offset],input->data[inpos+offset],ruleset.rule[i][lparen_idx+1+offset],ruleset.rule[i][lparen_idx+1+offset] );
-					if (input->data[inpos+offset] == ruleset.rule[i][lparen_idx+1+offset])
+#ifdef ORIGINAL_BUGS
+					if (!sub)
 					{
-						offset++;
+						if (ci->tests & DFA_T_SIBIL) consume = true;
+						else if ((ci->ch == 'H') && !edge) sub = 1;
+						else return DFA_FAIL;
 					}
-					else
+					else if ((ci->ch == 'C') || (ci->ch == 'S')) consume = true;
+					else return DFA_FAIL;
+#else
+					if (!sub)
 					{
-						break;
+						if (((ci->ch == 'C') || (ci->ch == 'S')) && !edge) sub = (ci->tests & DFA_T_SIBIL) ? 1 : 2;
+						else if (ci->tests & DFA_T_SIBIL) consume = true;
+						else return DFA_FAIL;
 					}
+					else if (ci->ch == 'H') consume = true;
+					else if (sub == 1) skip = true;
+					else return DFA_FAIL;
+#endif
 				}
-			}
-			*/
-			//e_printf(V_DEBUG, "attempted strncmp of rule resulted in %d\n",n);
-			if (n != 0) continue; // mismatch, go to next rule.
-			// if we got here, the fixed part of the rule matched.
-			e_printf(V_SEARCH2, "rule %s matched the input string, at rule offset %d\n", ruleset.rule[i], lparen_idx+1);
-		}
-
-		// part2: match the rule prefix
-		{
-			bool fail = false;
-			s32 ruleoffset = -1;
-			s32 inpoffset = -1;
-			int rulechar;
-			int inpchar;
-			while ((!fail)&&(lparen_idx+ruleoffset >= 0)&&(inpos+inpoffset >= 0))
-			{
-				rulechar = ruleset.rule[i][lparen_idx+ruleoffset];
-				inpchar = input->data[inpos+inpoffset];
-				e_printf(V_SEARCH2, "rulechar is %c(%02x) at ruleoffset %d, inpchar is %c(%02x) at inpoffset %d\n", rulechar, rulechar, lparen_idx+ruleoffset, inpchar, inpchar, inpos+inpoffset);
-				if (isLetter(rulechar, c)) // letter in rule matches that letter exactly, only.
+				break;
+			case DFA_OP_UAFF:
+				if (side->left)
 				{
-					// it's a letter, directly compare it to the input character
-					if (rulechar == inpchar)
+					if (!sub)
 					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else
-					{
-						// mismatch
-						fail = true;
+						if (ci->tests & DFA_T_UAFF) consume = true;
+#ifndef ORIGINAL_BUGS
+						else if (ci->ch == 'H') sub = 1;
+#endif
+						else return DFA_FAIL;
 					}
+					else if ((ci->ch == 'T') || (ci->ch == 'C') || (ci->ch == 'S')) consume = true;
+					else return DFA_FAIL;
 				}
-				else if (rulechar == ' ') // space matches one non-letter
+				else
 				{
-					if (!isLetter(inpchar,c))
-					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else
+#ifdef ORIGINAL_BUGS
+					if (ci->tests & DFA_T_UAFF) consume = true;
+					else return DFA_FAIL;
+#else
+					if (!sub)
 					{
-						// mismatch
-						fail = true;
+						if (((ci->ch == 'T') || (ci->ch == 'C') || (ci->ch == 'S')) && !edge) sub = (ci->tests & DFA_T_UAFF) ? 1 : 2;
+						else if (ci->tests & DFA_T_UAFF) consume = true;
+						else return DFA_FAIL;
 					}
+					else if (ci->ch == 'H') consume = true;
+					else if (sub == 1) skip = true;
+					else return DFA_FAIL;
+#endif
 				}
-				// The NRL rules have '#' match 'one or more vowels', while the SV rules have '#' match 'exactly one vowel'
-				// NRL rules also allow '##' to match 'two or more vowels' which requires look-ahead or a recursive parser
-				// which does a DFS or BFS of every potentially matching character. We cheat and look ahead here.
-#ifdef NRL_VOWEL
-				else if (rulechar == '#') // # matches one or more vowels
+				break;
+			case DFA_OP_ENDING:
+				// sub: 1 after 'E', 2 after 'EL', 3 after 'EF', 4 after 'EFU', 5 after 'I', 6 after 'IN'
+				switch (sub)
 				{
-					// special check here for the case where the rule has '##' in it
-					if ( (lparen_idx+(ruleoffset-1) >= 0) && ( ruleset.rule[i][lparen_idx+(ruleoffset-1)] == '#') ) // '##' case
-					{
-						e_printf(V_ERULES, "found a prefix rule with the problematic ## case\n");
-						// check for two vowels, plus any more.
-						if (isVowel(inpchar,c) && (inpos+(inpoffset-1) >= 0) && isVowel(input->data[inpos+(inpoffset-1)],c))
-						{
-							// match 2 vowels...
-							ruleoffset -= 2;
-							// yes, we recheck what we already just checked. this avoids a bad bug.
-							while ((inpos+(inpoffset-1) >= 0) && isVowel(inpchar,c))
-							{
-								// match another...
-								inpoffset--;
-								inpchar = input->data[inpos+inpoffset];
-							}
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
-					}
-					else // '#' case
-					{
-						if (isVowel(inpchar,c))
-						{
-							// match one...
-							ruleoffset--;
-							// yes, we recheck what we already just checked. this avoids a bad bug.
-							while ((inpos+(inpoffset-1) >= 0) && isVowel(inpchar,c))
-							{
-								// match another...
-								inpoffset--;
-								inpchar = input->data[inpos+inpoffset];
-							}
-						}
-						else
+					case 0:
+						if (ci->ch == 'E')
 						{
-							// mismatch
-							fail = true;
+							if (edge) skip = true; // matched, but the 'E' isn't consumed
+							else sub = 1;
 						}
-					}
+						else if ((ci->ch == 'I') && !edge) sub = 5;
+						else return DFA_FAIL;
+						break;
+					case 1:
+						if ((ci->ch == 'R') || (ci->ch == 'S') || (ci->ch == 'D')) consume = true;
+						else if ((ci->ch == 'L') && !edge) sub = 2;
+						else if ((ci->ch == 'F') && !edge) sub = 3;
+						else skip = true;
+						break;
+					case 2:
+						if (ci->ch == 'Y') consume = true;
+						else lookahead = "L";
+						break;
+					case 3:
+						if ((ci->ch == 'U') && !edge) sub = 4;
+						else lookahead = "F";
+						break;
+					case 4:
+						if (ci->ch == 'L') consume = true;
+						else lookahead = "FU";
+						break;
+					case 5:
+						if ((ci->ch == 'N') && !edge) sub = 6;
+						else return DFA_FAIL;
+						break;
+					case 6:
+						if (ci->ch == 'G') consume = true;
+						else return DFA_FAIL;
+						break;
 				}
-#else
-				else if (rulechar == '#') // # matches one vowel
+				break;
+			case DFA_OP_CONS_EI:
+				if (side->left)
 				{
-					if (isVowel(inpchar,c))
-					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else
+					if (!sub)
 					{
-						// mismatch
-						fail = true;
+						if ((ci->ch == 'E') || (ci->ch == 'I')) sub = 1;
+						else return DFA_FAIL;
 					}
+					else if (ci->tests & DFA_T_CONS) consume = true;
+					else return DFA_FAIL;
 				}
-#endif
-				else if (rulechar == '.') // . matches one voiced consonant
+				else
 				{
-					if (isVoiced(inpchar,c))
-					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else
+					if (!sub)
 					{
-						// mismatch
-						fail = true;
+						if ((ci->tests & DFA_T_CONS) && !edge) sub = 1;
+						else return DFA_FAIL;
 					}
+					else if ((ci->ch == 'E') || (ci->ch == 'I')) consume = true;
+					else return DFA_FAIL;
 				}
-				else if (rulechar == '&') // & matches one sibilant; note the special cases for CH and SH
+				break;
+		}
+		if (lookahead)
+		{
+			// the look-ahead failed; the operation matched without it, so feed the following operation the consumed
+			// characters and then this one
+			op++;
+			sub = 0;
+			replay = lookahead;
+			continue;
+		}
+		if (consume)
+		{
+			op++;
+			sub = 0;
+			if (op == num_ops) return DFA_ACCEPT;
+		}
+		else if (skip)
+		{
+			op++;
+			sub = 0;
+			continue;
+		}
+		*thread = (rule<<18)|(op<<8)|sub;
+		return DFA_LIVE;
+	}
+}
+
+// end of input for a rule program state; running out of input matches the rest of the rule, unless an operation was
+// part way through a multiple character match
+INTERNAL u32 dfaFeedEnd(const dfa_side* side, const u32 thread)
+{
+	const u32 rule = thread>>18;
+	const u32 op = (thread>>8)&0x3ff;
+	const u32 kind = side->ops[side->op_start[rule]+op].kind;
+	if ((thread&0xff) && ((kind == DFA_OP_SIBIL) || (kind == DFA_OP_UAFF) || (kind == DFA_OP_ENDING) || (kind == DFA_OP_CONS_EI))) return DFA_FAIL;
+	return DFA_ACCEPT;
+}
+
+// find or add a set of accepted rules, returns its number or -1 if out of memory
+INTERNAL s32 internDfaAcc(sym_dfa* dfa, const u64* set)
+{
+	const size_t bytes = dfa->words * sizeof(u64);
+	if ((dfa->num_accs+1)*2 > dfa->acc_hash_size)
+	{
+		u32 size = dfa->acc_hash_size ? dfa->acc_hash_size*2 : 64;
+		u32* hash = calloc(size, sizeof(u32));
+		if (!hash) return -1;
+		for (u32 a = 0; a < dfa->num_accs; a++)
+		{
+			u32 h = hashBytes(&dfa->accs[a*dfa->words], bytes) & (size-1);
+			while (hash[h]) h = (h+1) & (size-1);
+			hash[h] = a+1;
+		}
+		free(dfa->acc_hash);
+		dfa->acc_hash = hash;
+		dfa->acc_hash_size = size;
+	}
+	u32 h = hashBytes(set, bytes) & (dfa->acc_hash_size-1);
+	while (dfa->acc_hash[h])
+	{
+		if (!memcmp(&dfa->accs[(dfa->acc_hash[h]-1)*dfa->words], set, bytes)) return dfa->acc_hash[h]-1;
+		h = (h+1) & (dfa->acc_hash_size-1);
+	}
+	if (dfa->num_accs == dfa->cap_accs)
+	{
+		u32 cap = dfa->cap_accs ? dfa->cap_accs*2 : 64;
+		u64* accs = realloc(dfa->accs, cap * bytes);
+		if (!accs) return -1;
+		dfa->accs = accs;
+		dfa->cap_accs = cap;
+	}
+	memcpy(&dfa->accs[dfa->num_accs*dfa->words], set, bytes);
+	dfa->acc_hash[h] = dfa->num_accs+1;
+	return dfa->num_accs++;
+}
+
+// find or add an automaton state from its (sorted) rule program states, returns its number or -1 if there are too many
+INTERNAL s32 internDfaState(sym_dfa* dfa, dfa_side* side, const u32* threads, const u32 n)
+{
+	const size_t bytes = n * sizeof(u32);
+	if ((side->num_states+1)*2 > side->state_hash_size)
+	{
+		u32 size = side->state_hash_size ? side->state_hash_size*2 : 64;
+		u32* hash = calloc(size, sizeof(u32));
+		if (!hash) return -1;
+		for (u32 s = 0; s < side->num_states; s++)
+		{
+			u32 h = hashBytes(&side->threads[side->state_pos[s]], (side->state_pos[s+1]-side->state_pos[s]) * sizeof(u32)) & (size-1);
+			while (hash[h]) h = (h+1) & (size-1);
+			hash[h] = s+1;
+		}
+		free(side->state_hash);
+		side->state_hash = hash;
+		side->state_hash_size = size;
+	}
+	u32 h = hashBytes(threads, bytes) & (side->state_hash_size-1);
+	while (side->state_hash[h])
+	{
+		u32 s = side->state_hash[h]-1;
+		if ((side->state_pos[s+1]-side->state_pos[s] == n) && !memcmp(&side->threads[side->state_pos[s]], threads, bytes)) return s;
+		h = (h+1) & (side->state_hash_size-1);
+	}
+	if (side->num_states == DFA_MAX_STATES) return -1;
+	if (side->num_states == side->cap_states)
+	{
+		u32 cap = side->cap_states ? side->cap_states*2 : 64;
+		u32* state_pos = realloc(side->state_pos, (cap+1) * sizeof(u32));
+		if (state_pos) side->state_pos = state_pos;
+		dfa_trans* trans = realloc(side->trans, cap * dfa->num_symbols * sizeof(dfa_trans));
+		if (trans) side->trans = trans;
+		if (!state_pos || !trans) return -1;
+		side->cap_states = cap;
+	}
+	if (side->threads_size + n > side->threads_cap)
+	{
+		u32 cap = side->threads_cap ? side->threads_cap : 256;
+		while (cap < side->threads_size + n) cap *= 2;
+		u32* t = realloc(side->threads, cap * sizeof(u32));
+		if (!t) return -1;
+		side->threads = t;
+		side->threads_cap = cap;
+	}
+	const u32 s = side->num_states++;
+	if (n) memcpy(&side->threads[side->threads_size], threads, bytes);
+	side->threads_size += n;
+	side->state_pos[s+1] = side->threads_size;
+	for (u32 k = 0; k < dfa->num_symbols; k++)
+	{
+		side->trans[s*dfa->num_symbols+k].next = -1;
+		side->trans[s*dfa->num_symbols+k].acc = -1;
+	}
+	side->state_hash[h] = s+1;
+	return s;
+}
+
+// build the transition of a state on an input symbol
+INTERNAL bool expandDfaState(sym_dfa* dfa, dfa_side* side, const u32 s, const u32 sym)
+{
+	u64* acc = dfa->acc_scratch;
+	memset(acc, 0, dfa->words * sizeof(u64));
+	bool any = false;
+	u32 n = 0;
+	for (u32 k = side->state_pos[s]; k < side->state_pos[s+1]; k++)
+	{
+		u32 thread = side->threads[k];
+		u32 r;
+		if (sym == dfa->num_symbols-1) r = dfaFeedEnd(side, thread);
+		else r = dfaFeed(dfa, side, &thread, sym % dfa->num_classes, sym >= dfa->num_classes);
+		if (r == DFA_ACCEPT)
+		{
+			acc[(thread>>18)>>6] |= 1ULL<<((thread>>18)&63);
+			any = true;
+		}
+		else if (r == DFA_LIVE) dfa->scratch[n++] = thread;
+	}
+	s32 next = internDfaState(dfa, side, dfa->scratch, n);
+	s32 a = any ? internDfaAcc(dfa, acc) : -1;
+	if ((next < 0) || (any && (a < 0))) return false;
+	side->trans[s*dfa->num_symbols+sym].next = next;
+	side->trans[s*dfa->num_symbols+sym].acc = a;
+	return true;
+}
+
+INTERNAL void freeRuleDfa(sym_dfa* dfa)
+{
+	for (u32 d = 0; d < 2; d++)
+	{
+		dfa_side* side = &dfa->side[d];
+		free(side->ops);
+		free(side->op_start);
+		free(side->state_pos);
+		free(side->threads);
+		free(side->trans);
+		free(side->state_hash);
+	}
+	free(dfa->accs);
+	free(dfa->acc_hash);
+	free(dfa->scratch);
+	free(dfa->acc_scratch);
+	memset(dfa, 0, sizeof(*dfa));
+}
+
+// compile the rule programs and character classes of a rule list, and create the start states of its automaton
+INTERNAL bool buildRuleDfa(sym_dfa* dfa, const sym_rule* const * rules, const u32 num_rules, s_cfg c)
+{
+	memset(dfa, 0, sizeof(*dfa));
+	dfa->built = true;
+	if (num_rules > DFA_MAX_RULES) return false;
+	dfa->num_rules = num_rules;
+	dfa->words = (num_rules+63)>>6;
+	if (!dfa->words) dfa->words = 1;
+	dfa->scratch = malloc((num_rules+1) * sizeof(u32));
+	dfa->acc_scratch = calloc(3 * dfa->words, sizeof(u64));
+	if (!dfa->scratch || !dfa->acc_scratch) return false;
+	// rule programs
+	bool special[0x80] = {0};
+	for (const char* s = DFA_SPECIAL_CHARS; *s; s++) special[(u8)*s] = true;
+	for (u32 d = 0; d < 2; d++)
+	{
+		dfa_side* side = &dfa->side[d];
+		side->left = (d == 1);
+		u32 total = 0;
+		for (u32 i = 0; i < num_rules; i++) total += side->left ? rules[i]->prefix_len : rules[i]->match_len + rules[i]->suffix_len;
+		side->ops = malloc((total+1) * sizeof(dfa_op));
+		side->op_start = malloc((num_rules+1) * sizeof(u32));
+		if (!side->ops || !side->op_start) return false;
+		u32 pos = 0;
+		for (u32 i = 0; i < num_rules; i++)
+		{
+			const sym_rule* const r = rules[i];
+			u32 n = 0;
+			side->op_start[i] = pos;
+			if (!side->left)
+			{
+				// the exact match part, compared character by character
+				for (u32 k = 0; k < r->match_len; k++)
 				{
-					if (isSibil(inpchar,c))
-					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else if (inpchar == 'H') // could be CH or SH!
-					{
-						// the beginning of the input array is ALWAYS a space, so since we saw an 'H'
-						// we can't be at offset less than 1 here, so it is always safe to index back one more character
-						// unlike many other similar tests in the original reciter code, this one actually works.
-						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
-						if ((inpchar == 'C') || (inpchar == 'S'))
-						{
-							// match 2 characters
-							ruleoffset--;
-							inpoffset -= 2;
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
-					}
-					else
-					{
-						// mismatch
-						fail = true;
-					}
+					side->ops[pos+k].kind = DFA_OP_LIT;
+					side->ops[pos+k].ch = r->match[k];
+					side->ops[pos+k].test = 0;
+					special[r->match[k]&0x7f] = true;
 				}
-				else if (rulechar == '@') // @ matches one unvoiced affricate aka nonpalate; note special cases for TH, CH, SH
+				pos += r->match_len;
+			}
+			if (!compileDfaSide(side->left ? r->prefix : r->suffix, side->left ? r->prefix_len : r->suffix_len, side->left, &side->ops[pos], &n, &dfa->mactalk_symbols, c)) return false;
+			for (u32 k = 0; k < n; k++)
+			{
+				if (side->ops[pos+k].kind == DFA_OP_LIT) special[side->ops[pos+k].ch&0x7f] = true;
+			}
+			pos += n;
+			if (pos - side->op_start[i] > DFA_MAX_OPS) return false;
+		}
+		side->op_start[num_rules] = pos;
+	}
+	// character classes
+	u32 keys[0x100];
+	for (u32 v = 0; v < 0x100; v++)
+	{
+		const u8 f = c.ascii_features[v&0x7f];
+		u16 tests = (f & A_LETTER) ? DFA_T_LETTER : DFA_T_NOTLETTER;
+		if (f & A_VOWEL) tests |= DFA_T_VOWEL;
+		if (f & A_VOICED) tests |= DFA_T_VOICED;
+		if (f & A_CONS) tests |= DFA_T_CONS;
+		if (f & A_DIGIT) tests |= DFA_T_DIGIT;
+		if (f & A_SIBIL) tests |= DFA_T_SIBIL;
+		if (f & A_UAFF) tests |= DFA_T_UAFF;
+		if ((v < 0x80) && isFront(v, c)) tests |= DFA_T_FRONT;
+		const bool direct = (v < 0x80) && special[v];
+		const u32 key = direct ? v : 0x100|tests;
+		u32 k;
+		for (k = 0; k < dfa->num_classes; k++)
+		{
+			if (keys[k] == key) break;
+		}
+		if (k == dfa->num_classes)
+		{
+			keys[k] = key;
+			dfa->cinfo[k].tests = tests;
+			dfa->cinfo[k].ch = direct ? v : 0;
+			dfa->num_classes++;
+		}
+		dfa->cmap[v] = k;
+	}
+	dfa->num_symbols = dfa->num_classes*2 + 1;
+	// start states; state 0 of each side is the dead state
+	for (u32 d = 0; d < 2; d++)
+	{
+		dfa_side* side = &dfa->side[d];
+		u64* acc = dfa->acc_scratch;
+		memset(acc, 0, dfa->words * sizeof(u64));
+		bool any = false;
+		u32 n = 0;
+		side->state_pos = malloc(sizeof(u32));
+		if (!side->state_pos) return false;
+		side->state_pos[0] = 0;
+		if (internDfaState(dfa, side, dfa->scratch, 0) != 0) return false;
+		for (u32 i = 0; i < num_rules; i++)
+		{
+			if (side->op_start[i] == side->op_start[i+1])
+			{
+				acc[i>>6] |= 1ULL<<(i&63);
+				any = true;
+			}
+			else dfa->scratch[n++] = i<<18;
+		}
+		side->init_acc = any ? internDfaAcc(dfa, acc) : -1;
+		side->start = internDfaState(dfa, side, dfa->scratch, n);
+		if ((side->start < 0) || (any && (side->init_acc < 0))) return false;
+	}
+	dfa->ok = true;
+	return true;
+}
+
+// run one side of the automaton from position p, and merge the rules it accepted into acc; returns false if the
+// automaton ran out of states
+INTERNAL bool runDfaSide(sym_dfa* dfa, dfa_side* side, const vec_u8* const input, s32 p, u64* acc)
+{
+	memset(acc, 0, dfa->words * sizeof(u64));
+	if (side->init_acc >= 0) memcpy(acc, &dfa->accs[side->init_acc*dfa->words], dfa->words * sizeof(u64));
+	const s32 step = side->left ? -1 : 1;
+	const s32 edge = side->left ? 0 : (s32)input->elements;
+	s32 s = side->start;
+	while (s)
+	{
+		u32 sym;
+		if (side->left ? (p < 0) : (p > edge)) sym = dfa->num_symbols-1;
+		else
+		{
+			sym = dfa->cmap[input->data[p]] + ((p == edge) ? dfa->num_classes : 0);
+		}
+		if ((side->trans[s*dfa->num_symbols+sym].next < 0) && !expandDfaState(dfa, side, s, sym)) return false;
+		const dfa_trans* const t = &side->trans[s*dfa->num_symbols+sym];
+		if (t->acc >= 0)
+		{
+			const u64* const a = &dfa->accs[t->acc*dfa->words];
+			for (u32 w = 0; w < dfa->words; w++) acc[w] |= a[w];
+		}
+		s = t->next;
+		p += step;
+	}
+	return true;
+}
+
+// compile every rule string of every ruleset variant; this is done once at startup so processRule only touches pre-parsed data.
+// if a rule is malformed, *malformed is set to it, otherwise to NULL.
+INTERNAL bool initRuleLibrary(rule_library* lib, const char** malformed)
+{
+	*malformed = NULL;
+	memset(lib, 0, sizeof(*lib));
+	// count the static rule strings, which bounds the number of distinct rules
+	u32 total = 0;
+	for (u32 v = 0; v < NUM_RULE_VARIANTS; v++)
+	{
+		for (u32 t = 0; t < RULES_TOTAL; t++)
+		{
+			total += rule_variants[v].rules[t].num_rules;
+		}
+	}
+	u32 hash_size = 1;
+	while ((hash_size < (total<<1)) || (hash_size < (NUM_RULE_HANDLES*RULES_TOTAL<<1))) hash_size <<= 1;
+	u32* hash = malloc(hash_size * sizeof(u32)); // holds index+1 into uniq (for rules) or into the list arrays (for lists), 0 is empty
+	u32* sid = malloc(total * sizeof(u32)); // distinct rule id of every static rule string, in version/table order
+	const char** uniq = malloc(total * sizeof(const char*)); // distinct rule strings
+	u32* ids = malloc(total * (RF_ALL+1) * sizeof(u32)); // distinct rule ids of every handle's rule lists, in handle/table order
+	u32* list_off = malloc(NUM_RULE_HANDLES * RULES_TOTAL * sizeof(u32)); // offset into ids of each handle's rule list
+	u32* list_len = malloc(NUM_RULE_HANDLES * RULES_TOTAL * sizeof(u32)); // number of rules in each handle's rule list
+	u32* list_pos = malloc(NUM_RULE_HANDLES * RULES_TOTAL * sizeof(u32)); // position in lib->lists of each handle's rule list
+	u32* list_num = malloc(NUM_RULE_HANDLES * RULES_TOTAL * sizeof(u32)); // distinct list number of each handle's rule list
+	u32* list_first = malloc(NUM_RULE_HANDLES * RULES_TOTAL * sizeof(u32)); // first handle rule list of each distinct list
+	bool ok = (hash && sid && uniq && ids && list_off && list_len && list_pos && list_num && list_first);
+
+	// pass 1: assign an id to every distinct rule string, ignoring the tags
+	if (ok)
+	{
+		u32 k = 0;
+		memset(hash, 0, hash_size * sizeof(u32));
+		for (u32 v = 0; v < NUM_RULE_VARIANTS; v++)
+		{
+			for (u32 t = 0; t < RULES_TOTAL; t++)
+			{
+				const sym_ruleset* src = &rule_variants[v].rules[t];
+				for (u32 i = 0; i < src->num_rules; i++)
 				{
-					if (isUaff(inpchar,c))
-					{
-						// match
-						ruleoffset--;
-						inpoffset--;
-					}
-					else if (inpchar == 'H') // could be TH, CH or SH!; NOTE: the original reciter has a bug here and these tests ALWAYS fail!
-					{
-#ifdef ORIGINAL_BUGS
-						// The original code forgets to decrement the pointer and load another character, so it compares
-						// the already loaded and compared 'H' against 'T', 'C', and 'S', which will always fail!
-						fail = true;
-#else
-						// the beginning of the input array is ALWAYS a space, so since we saw an 'H'
-						// we can't be at offset less than 1 here, so it is always safe to index back one more character
-						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
-						if ((inpchar == 'T') || (inpchar == 'C') || (inpchar == 'S'))
-						{
-							// match 2 characters
-							ruleoffset--;
-							inpoffset -= 2;
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
-#endif
-					}
-					else
+					const char* rule = src->rule[i] + (ruleTag(src->rule[i]) ? 1 : 0);
+					u32 h = hashBytes(rule, strlen(rule)) & (hash_size-1);
+					while (hash[h] && strcmp(uniq[hash[h]-1], rule)) h = (h+1) & (hash_size-1);
+					if (!hash[h])
 					{
-						// mismatch
-						fail = true;
+						uniq[lib->pool_size] = rule;
+						hash[h] = ++lib->pool_size;
 					}
+					sid[k++] = hash[h]-1;
 				}
-				else if (rulechar == '^') // ^ matches one consonant
+			}
+		}
+		// compile the distinct rules
+		lib->pool = malloc(lib->pool_size * sizeof(sym_rule));
+		ok = (lib->pool != NULL);
+		for (u32 i = 0; ok && (i < lib->pool_size); i++)
+		{
+			if (!compileRule(uniq[i], &lib->pool[i]))
+			{
+				*malformed = uniq[i];
+				ok = false;
+			}
+		}
+	}
+
+	// pass 2: select the rules of every variant's rule lists, find the distinct rule lists, and give each one a
+	// position in the shared list storage
+	if (ok)
+	{
+		u32 nref = 0;
+		u32 vbase = 0; // index into sid of the first rule of the current version
+		memset(hash, 0, hash_size * sizeof(u32));
+		for (u32 v = 0; v < NUM_RULE_VARIANTS; v++)
+		{
+			u32 tbase = vbase;
+			for (u32 f = 0; f <= RF_ALL; f++)
+			{
+				tbase = vbase;
+				for (u32 t = 0; t < RULES_TOTAL; t++)
 				{
-					if (isCons(inpchar,c))
+					const sym_ruleset* src = &rule_variants[v].rules[t];
+					u32 idx = (v*(RF_ALL+1) + f)*RULES_TOTAL + t;
+					list_off[idx] = nref;
+					for (u32 i = 0; i < src->num_rules; i++)
 					{
-						// match
-						ruleoffset--;
-						inpoffset--;
+						if (ruleTagSelected(ruleTag(src->rule[i]), f)) ids[nref++] = sid[tbase+i];
 					}
-					else
+					tbase += src->num_rules;
+					u32 n = list_len[idx] = nref - list_off[idx];
+					u32 h = hashBytes(&ids[list_off[idx]], n * sizeof(u32)) & (hash_size-1);
+					while (hash[h])
 					{
-						// mismatch
-						fail = true;
+						u32 other = hash[h]-1;
+						if ((list_len[other] == n) && (!memcmp(&ids[list_off[other]], &ids[list_off[idx]], n * sizeof(u32)))) break;
+						h = (h+1) & (hash_size-1);
 					}
-				}
-				else if (rulechar == '+') // + matches one front vowel: E, I or Y
-				{
-					if (isFront(inpchar,c))
+					if (!hash[h])
 					{
-						// match
-						ruleoffset--;
-						inpoffset--;
+						hash[h] = idx+1;
+						list_pos[idx] = lib->lists_size;
+						list_first[lib->num_lists] = idx;
+						list_num[idx] = lib->num_lists++;
+						lib->lists_size += n;
 					}
 					else
 					{
-						// mismatch
-						fail = true;
+						list_pos[idx] = list_pos[hash[h]-1];
+						list_num[idx] = list_num[hash[h]-1];
 					}
 				}
-				else if (rulechar == ':') // : matches zero or more consonants; this test can't fail, but it can consume consonants in the input
-				{
-					// one problem is the NRL rules often have '^' before ':' in the prefix (meaning 'one or more consonant'),
-					// and if we parse the ':' first we end up consuming all the consonants, leaving none for the '^'.
-					// we need to explicitly check for that here and leave a single consonant in the input if that's the case.
-					// this does NOT cover the circumstance with '^^:'. no NRL rules contain that chain, and you should be using ':^' or ':^^' anyway!
-					bool singleBeforeMulti = false;
-					if ( (lparen_idx+(ruleoffset-1) >= 0) && ( ruleset.rule[i][lparen_idx+(ruleoffset-1)] == '^') ) // '^:' case
+			}
+			vbase = tbase;
+		}
+		lib->num_refs = nref;
+		lib->lists = malloc(lib->lists_size * sizeof(const sym_rule*));
+		lib->indexes = calloc(lib->num_lists, sizeof(sym_index));
+		ok = ((lib->lists != NULL) || (!lib->lists_size)) && ((lib->indexes != NULL) || (!lib->num_lists));
+	}
+
+	// fill in the shared list storage, and point each variant's handle at it
+	if (ok)
+	{
+		for (u32 h = 0; h < NUM_RULE_HANDLES; h++)
+		{
+			rule_handle* handle = &lib->handles[h];
+			handle->variant = &rule_variants[h/(RF_ALL+1)];
+			handle->flags = h%(RF_ALL+1);
+			for (u32 t = 0; t < RULES_TOTAL; t++)
+			{
+				u32 idx = h*RULES_TOTAL + t;
+				for (u32 i = 0; i < list_len[idx]; i++)
+				{
+					lib->lists[list_pos[idx]+i] = &lib->pool[ids[list_off[idx]+i]];
+				}
+				handle->ruleset[t].num_rules = list_len[idx];
+				handle->ruleset[t].rule = NULL;
+				handle->ruleset[t].crule = &lib->lists[list_pos[idx]];
+				handle->ruleset[t].index = &lib->indexes[list_num[idx]];
+				handle->ruleset[t].dfa = NULL; // see initRuleTables
+				handle->ruleset[t].symbol = t;
+			}
+		}
+		// build the dispatch index of each distinct rule list
+		for (u32 n = 0; ok && (n < lib->num_lists); n++)
+		{
+			ok = buildRuleIndex(&lib->lists[list_pos[list_first[n]]], list_len[list_first[n]], &lib->indexes[n]);
+		}
+	}
+
+	free(hash);
+	free(sid);
+	free(uniq);
+	free(ids);
+	free(list_off);
+	free(list_len);
+	free(list_pos);
+	free(list_num);
+	free(list_first);
+	return ok;
+}
+
+INTERNAL void freeRuleLibrary(rule_library* lib)
+{
+	for (u32 n = 0; lib->indexes && (n < lib->num_lists); n++)
+	{
+		freeRuleIndex(&lib->indexes[n]);
+	}
+	free(lib->indexes);
+	free(lib->pool);
+	free(lib->lists);
+	memset(lib, 0, sizeof(*lib));
+}
+
+// find the compiled handle for a ruleset version and combination of rule switches, returns NULL if there is no such version
+INTERNAL const rule_handle* findRuleHandle(const rule_library* lib, u32 version, u32 flags)
+{
+	for (u32 v = 0; v < NUM_RULE_VARIANTS; v++)
+	{
+		if (rule_variants[v].version == version) return &lib->handles[v*(RF_ALL+1) + (flags & RF_ALL)];
+	}
+	return NULL;
+}
+
+// the rule tables of a handle, for one user of them at a time: the handle itself is shared and read only, but the
+// automaton of each rule list is built on its first use by matchRuleDfa(), so every user has automata of its own
+typedef struct rule_tables
+{
+	sym_ruleset ruleset[RULES_TOTAL];
+	sym_dfa automata[RULES_TOTAL];
+} rule_tables;
+
+INTERNAL void initRuleTables(rule_tables* r, const rule_handle* handle)
+{
+	memset(r->automata, 0, sizeof(r->automata));
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		r->ruleset[t] = handle->ruleset[t];
+		r->ruleset[t].dfa = &r->automata[t];
+	}
+}
+
+INTERNAL void freeRuleTables(rule_tables* r)
+{
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		freeRuleDfa(&r->automata[t]);
+	}
+}
+
+// rule profile: how often each rule of the selected ruleset was tried and matched, and how long matching its prefix and
+// suffix took, to find the rules and rule tables which are worth reordering or indexing. the rules are only tried one
+// at a time by the interpretive matcher, so with the automaton only the matches and the time per table are counted.
+typedef struct rule_counters
+{
+	u64 tried; // number of times the rule was tried
+	u64 exact; // number of times its exact match part matched, so its prefix was tried
+	u64 prefix; // number of times its prefix matched too, so its suffix was tried
+	u64 matched; // number of times the rule was used
+	u64 prefix_ticks; // time spent matching its prefix
+	u64 suffix_ticks; // time spent matching its suffix
+} rule_counters;
+
+struct rule_profile
+{
+	const sym_ruleset* ruleset;
+	rule_counters* rules[RULES_TOTAL]; // counters of each rule of each table
+	u64 lookup_ticks[RULES_TOTAL]; // time spent looking up a rule in each table, with either matcher
+};
+
+// timestamp for the rule profile; the unit is PROFILE_TICK_UNIT
+#ifdef USE_RDTSC
+#define PROFILE_TICK_UNIT "cycles"
+#define profileTicks() ((u64)__rdtsc())
+#elif defined(USE_MONOTONIC_CLOCK)
+#define PROFILE_TICK_UNIT "ns"
+INTERNAL u64 profileTicks()
+{
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return (u64)t.tv_sec * 1000000000 + t.tv_nsec;
+}
+#else
+#define PROFILE_TICK_UNIT "clock"
+#define profileTicks() ((u64)clock())
+#endif
+
+INTERNAL void freeRuleProfile(rule_profile* p)
+{
+	if (!p) return;
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		free(p->rules[t]);
+	}
+	free(p);
+}
+
+// allocate zeroed counters for every rule of a ruleset; returns NULL if memory runs out
+INTERNAL rule_profile* allocRuleProfile(const sym_ruleset* const ruleset)
+{
+	rule_profile* p = calloc(1, sizeof(rule_profile));
+	if (!p) return NULL;
+	p->ruleset = ruleset;
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		p->rules[t] = calloc(ruleset[t].num_rules ? ruleset[t].num_rules : 1, sizeof(rule_counters));
+		if (!p->rules[t])
+		{
+			freeRuleProfile(p);
+			return NULL;
+		}
+	}
+	return p;
+}
+
+// add the counters of from to into; both must profile the same ruleset version and rule switches
+INTERNAL void mergeRuleProfile(rule_profile* into, const rule_profile* from)
+{
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		into->lookup_ticks[t] += from->lookup_ticks[t];
+		for (u32 i = 0; i < into->ruleset[t].num_rules; i++)
+		{
+			rule_counters* const a = &into->rules[t][i];
+			const rule_counters* const b = &from->rules[t][i];
+			a->tried += b->tried;
+			a->exact += b->exact;
+			a->prefix += b->prefix;
+			a->matched += b->matched;
+			a->prefix_ticks += b->prefix_ticks;
+			a->suffix_ticks += b->suffix_ticks;
+		}
+	}
+}
+
+// the rules used to translate something, in order, as (table << 16) | rule number
+struct rule_log
+{
+	u32* used;
+	u32 num;
+	u32 capacity;
+};
+
+// add a rule to the log; if memory runs out, the rule just isn't logged
+INTERNAL void logRule(rule_log* log, const u32 table, const u32 rule)
+{
+	if (log->num == log->capacity)
+	{
+		const u32 capacity = log->capacity ? log->capacity << 1 : 64;
+		u32* const used = realloc(log->used, capacity * sizeof(u32));
+		if (!used) return;
+		log->used = used;
+		log->capacity = capacity;
+	}
+	log->used[log->num++] = (table << 16) | rule;
+}
+
+#ifdef NRL_VOWEL
+// The NRL rules have '#' match 'one or more vowels', while the SV rules have '#' match 'exactly one vowel'.
+// With runs like that, a rule side such as '#^:##' can split up the input in many ways, and a greedy scan can eat
+// characters a later rule symbol needs, so the NRL sides are matched by trying every split, remembering which rule
+// symbol and input position pairs have already been tried (and so failed); every pair is tried at most once.
+// Positions this far or further from the start of a rule side aren't remembered, which no real word gets near.
+#define NRL_MEMO_SPAN 256
+
+typedef struct nrl_memo
+{
+	u32 start; // input position the rule side starts at
+	s32 dir; // 1 for a suffix, -1 for a prefix, which is matched backwards
+	u64 tried[256][2][NRL_MEMO_SPAN/64]; // [rule symbol][whether in a run][distance from start]
+} nrl_memo;
+
+// returns whether this pair was tried before, and marks it as tried
+INTERNAL bool nrlTried(nrl_memo* const memo, const u32 k, const u32 run, const s32 p)
+{
+	const u32 d = (p - (s32)memo->start) * memo->dir;
+	if (d >= NRL_MEMO_SPAN) return false;
+	u64* const w = &memo->tried[k][run][d>>6];
+	const u64 bit = 1ULL << (d & 63);
+	const bool tried = (*w & bit) != 0;
+	*w |= bit;
+	return tried;
+}
+
+// whether the n characters of the input starting at p, going in direction dir, are the string s in text order
+INTERNAL bool nrlText(const vec_u8* const input, const s32 p, const s32 dir, const char* const s, const u32 n)
+{
+	const s32 first = (dir > 0) ? p : p - (s32)n + 1;
+	if ((first < 0) || (first + (s32)n - 1 > (s32)input->elements)) return false;
+	return !memcmp(&input->data[first], s, n);
+}
+
+// whether the input character at p passes the test of a rule symbol which matches a single character
+INTERNAL bool nrlTest(const char rulechar, const vec_u8* const input, const s32 p, s_cfg c)
+{
+	if ((p < 0) || (p > (s32)input->elements)) return false;
+	const u8 inpchar = input->data[p];
+	switch (rulechar)
+	{
+		case '#': return isVowel(inpchar,c);
+		case '*': case ':': case '^': return isCons(inpchar,c);
+		case '.': return isVoiced(inpchar,c);
+		case '+': return isFront(inpchar,c);
+		case '&': return isSibil(inpchar,c);
+		case '@': return isUaff(inpchar,c);
+		case '?': case '_': return isDigit(inpchar,c);
+		case ' ': return !isLetter(inpchar,c);
+		default: return rulechar == inpchar;
+	}
+}
+
+// match the rule side symbols from k on against the input from p on; returns 1 on a match, 0 on a mismatch or -1 if
+// the rule has an invalid character in it
+INTERNAL s32 nrlMatch(const char* const side, const u32 len, const u32 k, const vec_u8* const input, s32 p, nrl_memo* const memo, s_cfg c)
+{
+	if (k == len) return 1;
+	if (nrlTried(memo, k, 0, p)) return 0;
+	const s32 dir = memo->dir;
+	const char rulechar = (dir < 0) ? side[len-1-k] : side[k];
+	bool repeat = false;
+	s32 r;
+	if (isLetter(rulechar, c) || (rulechar == ' ') || (rulechar == '.') || (rulechar == '^') || (rulechar == '+')
+		|| ((rulechar == '?') && (c.rules_version >= RULES_MACTALK)))
+	{
+		return nrlTest(rulechar, input, p, c) ? nrlMatch(side, len, k+1, input, p+dir, memo, c) : 0;
+	}
+	else if (rulechar == '&') // & matches one sibilant, or CH or SH
+	{
+		if (nrlTest(rulechar, input, p, c) && (r = nrlMatch(side, len, k+1, input, p+dir, memo, c))) return r;
+		if (nrlText(input, p, dir, "CH", 2) || nrlText(input, p, dir, "SH", 2)) return nrlMatch(side, len, k+1, input, p+2*dir, memo, c);
+		return 0;
+	}
+	else if (rulechar == '@') // @ matches one nonpalate, or TH, CH or SH
+	{
+		if (nrlTest(rulechar, input, p, c) && (r = nrlMatch(side, len, k+1, input, p+dir, memo, c))) return r;
+		if (nrlText(input, p, dir, "TH", 2) || nrlText(input, p, dir, "CH", 2) || nrlText(input, p, dir, "SH", 2)) return nrlMatch(side, len, k+1, input, p+2*dir, memo, c);
+		return 0;
+	}
+	else if (rulechar == '%') // % matches E, ER, ES, ED, ELY, EFUL or ING
+	{
+		static const char* const endings[] = { "E", "ER", "ES", "ED", "ELY", "EFUL", "ING" };
+		for (u32 e = 0; e < sizeof(endings)/sizeof(*endings); e++)
+		{
+			const u32 n = strlen(endings[e]);
+			if (nrlText(input, p, dir, endings[e], n) && (r = nrlMatch(side, len, k+1, input, p+(s32)n*dir, memo, c))) return r;
+		}
+		return 0;
+	}
+#ifdef SUPPORT_CONS1EI
+	else if (rulechar == '$') // $ matches one consonant followed by E or I
+	{
+		const s32 cons = (dir > 0) ? p : p-1;
+		if (nrlTest('^', input, cons, c) && (nrlTest('E', input, cons+1, c) || nrlTest('I', input, cons+1, c)))
+		{
+			return nrlMatch(side, len, k+1, input, p+2*dir, memo, c);
+		}
+		return 0;
+	}
+#endif
+	else if ((rulechar == '#')
+#ifdef SUPPORT_CONS1M
+		|| (rulechar == '*')
+#endif
+		) // # and * match one or more vowels or consonants
+	{
+		if (!nrlTest(rulechar, input, p, c)) return 0;
+		p += dir;
+		repeat = true;
+	}
+	else if ((rulechar == ':') || ((rulechar == '_') && (c.rules_version >= RULES_MACTALK))) // : and _ match zero or more consonants or digits
+	{
+		repeat = true;
+	}
+	if (!repeat)
+	{
+		e_printf(V_XLATE_ERR, "got an invalid rule character of '%c'(0x%02x)!\n", rulechar, rulechar);
+		return -1;
+	}
+	// try the rest of the rule after every length of the run; if the run from some position on was already tried,
+	// so was everything after it
+	while (!nrlTried(memo, k, 1, p))
+	{
+		if ((r = nrlMatch(side, len, k+1, input, p, memo, c))) return r;
+		if (!nrlTest(rulechar, input, p, c)) break;
+		p += dir;
+	}
+	return 0;
+}
+
+// match a rule prefix backwards from the input position before its exact match part, or a suffix forwards from the
+// position after it; returns 1 on a match, 0 on a mismatch or -1 if the rule has an invalid character in it
+INTERNAL s32 nrlMatchSide(const char* const side, const u32 len, const bool left, const vec_u8* const input, const s32 start, s_cfg c)
+{
+	if (!len) return 1;
+	nrl_memo memo;
+	memo.start = start;
+	memo.dir = left ? -1 : 1;
+	memset(memo.tried, 0, sizeof(memo.tried[0]) * len);
+	return nrlMatch(side, len, 0, input, start, &memo, c);
+}
+#endif
+
+#ifdef USE_SSE2
+// compare the exact match part of a rule against the input at in, the first 16 characters with one vector compare
+// against the rule's padded copy of them. the input always has RECITER_PAD bytes of zeroes past its end, so 16 bytes
+// can be read from any position in it, and a rule never matches past the end since rules don't contain zeroes.
+static inline bool matchExact(const sym_rule* const r, const u8* const in)
+{
+	const __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128((const __m128i*)in), _mm_loadu_si128((const __m128i*)r->match_pad));
+	if ((_mm_movemask_epi8(eq) & r->match_mask) != r->match_mask) return false;
+	// the rest of a longer exact match part, if any; stops at the first mismatch, at the latest in the padding
+	for (u32 offset = sizeof(r->match_pad); offset < r->match_len; offset++)
+	{
+		if (in[offset] != (u8)r->match[offset]) return false;
+	}
+	return true;
+}
+#endif
+
+// find the first rule of the ruleset which matches the input at inpos by trying the rules in turn; returns the rule
+// number, -1 if no rule matched, or -3 if a rule has an invalid character in it
+INTERNAL s32 matchRuleInterp(const sym_ruleset ruleset, const vec_u8* const input, const u32 inpos, s_cfg c)
+{
+#ifndef NRL_VOWEL
+	const u8* const feat = c.features->data; // see classifyInput
+#endif
+	// narrow the rules down to the candidates whose exact match part can start with the next one or two input characters;
+	// the candidates are in rule order, so the first matching rule is still the one which wins
+	const u16* cand = NULL;
+	u32 k = 0;
+	u32 kend = ruleset.num_rules;
+	if (c.use_index && ruleset.index)
+	{
+		const sym_index* const idx = ruleset.index;
+		u8 g = idx->group[input->data[inpos]&0x7f];
+		if (g)
+		{
+			u32 b = idx->base[g-1] + idx->cls[((g-1)<<7) + (input->data[inpos+1]&0x7f)];
+			cand = idx->cand;
+			k = idx->bucket[b];
+			kend = idx->bucket[b+1];
+		}
+		else
+		{
+			kend = 0; // no rule can match this character
+		}
+	}
+	// iterate through the rules
+	for (; k < kend; k++)
+	{
+		const u32 i = cand ? cand[k] : k;
+		const sym_rule* const r = ruleset.crule[i];
+		c.stats->tried[ruleset.symbol]++;
+		rule_counters* const prof = c.profile ? &c.profile->rules[ruleset.symbol][i] : NULL;
+		if (prof) prof->tried++;
+		t_printf(V_SEARCH, "found a rule %s\n", r->text);
+		// part 1: check the exact match section of the rule, between the parentheses
+		// the section boundaries and lengths were precomputed by compileRule(), and are used in parts 2 and 3 as well
+		int nbase = r->match_len; // number of letters in exact match part of the rule
+
+		// part1: compare exact match; basically a slightly customized 'strncmp()'
+		{
+#ifdef USE_SSE2
+			if (!matchExact(r, &input->data[inpos])) continue; // mismatch, go to next rule.
+#else
+			int n = nbase;
+			int offset = 0; // offset within rule of exact match
+			while ( n && (input->data[inpos+offset]) && (input->data[inpos+offset] == r->match[offset]) )
+			{
+				//e_printf(V_DEBUG, "strncmp - attempting to match %c(%02x) to %c(%02x)\n",input->data[inpos+offset],input->data[inpos+offset],r->match[offset],r->match[offset] );
+				offset++;
+				n--;
+			}
+			/*
+			for (; n > 0; n--)
+			{
+				if (!input->data[inpos+offset])
+				{
+					e_printf(V_DEBUG, "strncmp got null/end of string, bailing out!\n");
+					break;
+				}
+				else
+				{
+					e_printf(V_DEBUG, "strncmp - attempting to match %c(%02x) to %c(%02x)\n",input->data[inpos+offset],input->data[inpos+offset],r->match[offset],r->match[offset] );
+					if (input->data[inpos+offset] == r->match[offset])
 					{
-						e_printf(V_ERULES, "found a prefix rule with the problematic ^: case\n");
-						singleBeforeMulti = true;
+						offset++;
 					}
-					bool matchedCons = false;
-					ruleoffset--;
-					while ((inpos+(inpoffset-1) >= 0) && isCons(inpchar,c))
+					else
 					{
-						matchedCons = true;
+						break;
+					}
+				}
+			}
+			*/
+			//e_printf(V_DEBUG, "attempted strncmp of rule resulted in %d\n",n);
+			if (n != 0) continue; // mismatch, go to next rule.
+#endif
+			// if we got here, the fixed part of the rule matched.
+			t_printf(V_SEARCH2, "rule %s matched the input string, at rule offset %d\n", r->text, r->prefix_len+1);
+		}
+		u64 ticks = 0;
+		if (prof)
+		{
+			prof->exact++;
+			ticks = profileTicks();
+		}
+
+		// part2: match the rule prefix
+		{
+			bool fail = false;
+#ifdef NRL_VOWEL
+			const s32 m = nrlMatchSide(r->prefix, r->prefix_len, true, input, (s32)inpos-1, c);
+			if (m < 0) return -3;
+			fail = !m;
+#else
+			s32 ruleoffset = -1;
+			s32 inpoffset = -1;
+			int rulechar;
+			int inpchar;
+			while ((!fail)&&(r->prefix_len+ruleoffset >= 0)&&((s32)inpos+inpoffset >= 0))
+			{
+				rulechar = r->prefix[r->prefix_len+ruleoffset];
+				inpchar = input->data[inpos+inpoffset];
+				t_printf(V_SEARCH2, "rulechar is %c(%02x) at ruleoffset %d, inpchar is %c(%02x) at inpoffset %d\n", rulechar, rulechar, r->prefix_len+ruleoffset, inpchar, inpchar, inpos+inpoffset);
+				if (isLetter(rulechar, c)) // letter in rule matches that letter exactly, only.
+				{
+					// it's a letter, directly compare it to the input character
+					if (rulechar == inpchar)
+					{
+						// match
+						ruleoffset--;
 						inpoffset--;
-						inpchar = input->data[inpos+inpoffset];
 					}
-					if (singleBeforeMulti && matchedCons)
+					else
 					{
-						// in this very specific case, we're courteous and leave one extra character on the input, so the ^ has something to eat
-						inpoffset++;
+						// mismatch
+						fail = true;
 					}
 				}
-				// The NRL parser allows a rule character of '*' which is 'one or more consonants'
-				// but none of the rules in the set in the published papers actually use this symbol.
-				// Perhaps the lost older rule sets did. We can support it anyway.
-#ifdef SUPPORT_CONS1M
-				else if (rulechar == '*') // * matches one or more consonants
+				else if (rulechar == ' ') // space matches one non-letter
 				{
-					if (isCons(inpchar,c))
+					if (!(feat[inpos+inpoffset] & A_LETTER))
 					{
-						// match one...
+						// match
 						ruleoffset--;
-						// yes, we recheck what we already just checked. this avoids a bad bug.
-						while ((inpos+(inpoffset-1) >= 0) && isCons(inpchar,c))
-						{
-							// match another...
-							inpoffset--;
-							inpchar = input->data[inpos+inpoffset];
-						}
+						inpoffset--;
 					}
 					else
 					{
@@ -672,29 +2232,14 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-#endif
-				// The NRL parser allows a rule character of '$' which is 'a consonant followed by E or I'
-				// but none of the rules in the set in the published papers actually use this symbol.
-				// Perhaps the lost older rule sets did. We can support it anyway.
-#ifdef SUPPORT_CONS1EI
-				else if (rulechar == '$') // $ matches one consonant followed by 'I' or 'E'
+				// the SV rules have '#' match exactly one vowel; see nrlMatchSide() for the NRL 'one or more vowels'
+				else if (rulechar == '#') // # matches one vowel
 				{
-					if ( (inpchar == 'E') || (inpchar == 'I') ) // '^E' and '^I' cases
+					if ((feat[inpos+inpoffset] & A_VOWEL))
 					{
-						// the beginning of the input array is ALWAYS a space, so since we saw an 'E' or 'I'
-						// we can't be at offset less than 1 here, so it is always safe to index back one more character
-						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
-						if (isCons(inpchar,c))
-						{
-							// match 2 characters
-							ruleoffset--;
-							inpoffset -= 2;
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
+						// match
+						ruleoffset--;
+						inpoffset--;
 					}
 					else
 					{
@@ -702,12 +2247,9 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-				// Mactalk and later has two extra rule characters: ? (single digit) and _ (zero or more digits)
-				else if (rulechar == '?') // ? matches one digit
+				else if (rulechar == '.') // . matches one voiced consonant
 				{
-					if (isDigit(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_VOICED))
 					{
 						// match
 						ruleoffset--;
@@ -719,37 +2261,242 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-				else if (rulechar == '_') // _ matches zero or more digits; this test can't fail, but it can consume digits in the input
+				else if (rulechar == '&') // & matches one sibilant; note the special cases for CH and SH
 				{
-					ruleoffset--;
-					while ((inpos+(inpoffset-1) >= 0) && isDigit(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_SIBIL))
 					{
+						// match
+						ruleoffset--;
 						inpoffset--;
-						inpchar = input->data[inpos+inpoffset];
 					}
-				}
+					else if (inpchar == 'H') // could be CH or SH!
+					{
+						// the beginning of the input array is ALWAYS a space, so since we saw an 'H'
+						// we can't be at offset less than 1 here, so it is always safe to index back one more character
+						// unlike many other similar tests in the original reciter code, this one actually works.
+						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
+						if ((inpchar == 'C') || (inpchar == 'S'))
+						{
+							// match 2 characters
+							ruleoffset--;
+							inpoffset -= 2;
+						}
+						else
+						{
+							// mismatch
+							fail = true;
+						}
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+				else if (rulechar == '@') // @ matches one unvoiced affricate aka nonpalate; note special cases for TH, CH, SH
+				{
+					if ((feat[inpos+inpoffset] & A_UAFF))
+					{
+						// match
+						ruleoffset--;
+						inpoffset--;
+					}
+					else if (inpchar == 'H') // could be TH, CH or SH!; NOTE: the original reciter has a bug here and these tests ALWAYS fail!
+					{
+#ifdef ORIGINAL_BUGS
+						// The original code forgets to decrement the pointer and load another character, so it compares
+						// the already loaded and compared 'H' against 'T', 'C', and 'S', which will always fail!
+						fail = true;
+#else
+						// the beginning of the input array is ALWAYS a space, so since we saw an 'H'
+						// we can't be at offset less than 1 here, so it is always safe to index back one more character
+						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
+						if ((inpchar == 'T') || (inpchar == 'C') || (inpchar == 'S'))
+						{
+							// match 2 characters
+							ruleoffset--;
+							inpoffset -= 2;
+						}
+						else
+						{
+							// mismatch
+							fail = true;
+						}
+#endif
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+				else if (rulechar == '^') // ^ matches one consonant
+				{
+					if ((feat[inpos+inpoffset] & A_CONS))
+					{
+						// match
+						ruleoffset--;
+						inpoffset--;
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+				else if (rulechar == '+') // + matches one front vowel: E, I or Y
+				{
+					if (isFront(inpchar,c))
+					{
+						// match
+						ruleoffset--;
+						inpoffset--;
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+				else if (rulechar == ':') // : matches zero or more consonants; this test can't fail, but it can consume consonants in the input
+				{
+					// one problem is the NRL rules often have '^' before ':' in the prefix (meaning 'one or more consonant'),
+					// and if we parse the ':' first we end up consuming all the consonants, leaving none for the '^'.
+					// we need to explicitly check for that here and leave a single consonant in the input if that's the case.
+					// this does NOT cover the circumstance with '^^:'. no NRL rules contain that chain, and you should be using ':^' or ':^^' anyway!
+					bool singleBeforeMulti = false;
+					if ( (r->prefix_len+(ruleoffset-1) >= 0) && ( r->prefix[r->prefix_len+(ruleoffset-1)] == '^') ) // '^:' case
+					{
+						t_printf(V_ERULES, "found a prefix rule with the problematic ^: case\n");
+						singleBeforeMulti = true;
+					}
+					bool matchedCons = false;
+					ruleoffset--;
+					while (((s32)inpos+(inpoffset-1) >= 0) && (feat[inpos+inpoffset] & A_CONS))
+					{
+						matchedCons = true;
+						inpoffset--;
+						inpchar = input->data[inpos+inpoffset];
+					}
+					if (singleBeforeMulti && matchedCons)
+					{
+						// in this very specific case, we're courteous and leave one extra character on the input, so the ^ has something to eat
+						inpoffset++;
+					}
+				}
+				// The NRL parser allows a rule character of '*' which is 'one or more consonants'
+				// but none of the rules in the set in the published papers actually use this symbol.
+				// Perhaps the lost older rule sets did. We can support it anyway.
+#ifdef SUPPORT_CONS1M
+				else if (rulechar == '*') // * matches one or more consonants
+				{
+					if ((feat[inpos+inpoffset] & A_CONS))
+					{
+						// match one...
+						ruleoffset--;
+						// yes, we recheck what we already just checked. this avoids a bad bug.
+						while (((s32)inpos+(inpoffset-1) >= 0) && (feat[inpos+inpoffset] & A_CONS))
+						{
+							// match another...
+							inpoffset--;
+							inpchar = input->data[inpos+inpoffset];
+						}
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+#endif
+				// The NRL parser allows a rule character of '$' which is 'a consonant followed by E or I'
+				// but none of the rules in the set in the published papers actually use this symbol.
+				// Perhaps the lost older rule sets did. We can support it anyway.
+#ifdef SUPPORT_CONS1EI
+				else if (rulechar == '$') // $ matches one consonant followed by 'I' or 'E'
+				{
+					if ( (inpchar == 'E') || (inpchar == 'I') ) // '^E' and '^I' cases
+					{
+						// the beginning of the input array is ALWAYS a space, so since we saw an 'E' or 'I'
+						// we can't be at offset less than 1 here, so it is always safe to index back one more character
+						inpchar = input->data[inpos+(inpoffset-1)]; // load another char...
+						if (feat[inpos+(inpoffset-1)] & A_CONS)
+						{
+							// match 2 characters
+							ruleoffset--;
+							inpoffset -= 2;
+						}
+						else
+						{
+							// mismatch
+							fail = true;
+						}
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
 #endif
+				// Mactalk and later has two extra rule characters: ? (single digit) and _ (zero or more digits)
+				else if ((rulechar == '?') && (c.rules_version >= RULES_MACTALK)) // ? matches one digit
+				{
+					if ((feat[inpos+inpoffset] & A_DIGIT))
+					{
+						// match
+						ruleoffset--;
+						inpoffset--;
+					}
+					else
+					{
+						// mismatch
+						fail = true;
+					}
+				}
+				else if ((rulechar == '_') && (c.rules_version >= RULES_MACTALK)) // _ matches zero or more digits; this test can't fail, but it can consume digits in the input
+				{
+					ruleoffset--;
+					while (((s32)inpos+(inpoffset-1) >= 0) && (feat[inpos+inpoffset] & A_DIGIT))
+					{
+						inpoffset--;
+						inpchar = input->data[inpos+inpoffset];
+					}
+				}
 				else
 				{
-					e_printf(V_ERR, "got an invalid rule character of '%c'(0x%02x), exiting!\n", rulechar, rulechar);
-					exit(1);
+					e_printf(V_XLATE_ERR, "got an invalid rule character of '%c'(0x%02x)!\n", rulechar, rulechar);
+					return -3;
 				}
 			}
+#endif
+			if (prof)
+			{
+				const u64 now = profileTicks();
+				prof->prefix_ticks += now - ticks;
+				ticks = now;
+			}
 			if (fail) continue; // mismatch, move on to the next rule.
+			if (prof) prof->prefix++;
 		}
 
 		// part3: match the rule suffix
 		{
 			bool fail = false;
-			s32 ruleoffset = 1;
+#ifdef NRL_VOWEL
+			const s32 m = nrlMatchSide(r->suffix, r->suffix_len, false, input, inpos+nbase, c);
+			if (m < 0) return -3;
+			fail = !m;
+#else
+			s32 ruleoffset = 0;
 			s32 inpoffset = nbase;
 			int rulechar;
 			int inpchar;
-			while ((!fail)&&(rparen_idx+ruleoffset < equals_idx)&&(inpos+inpoffset <= input->elements))
+			while ((!fail)&&(ruleoffset < r->suffix_len)&&(inpos+inpoffset <= input->elements))
 			{
-				rulechar = ruleset.rule[i][rparen_idx+ruleoffset];
+				rulechar = r->suffix[ruleoffset];
 				inpchar = input->data[inpos+inpoffset];
-				e_printf(V_SEARCH2, "rulechar is %c(%02x) at ruleoffset %d, inpchar is %c(%02x) at inpoffset %d\n", rulechar, rulechar, rparen_idx+ruleoffset, inpchar, inpchar, inpos+inpoffset);
+				t_printf(V_SEARCH2, "rulechar is %c(%02x) at ruleoffset %d, inpchar is %c(%02x) at inpoffset %d\n", rulechar, rulechar, ruleoffset, inpchar, inpchar, inpos+inpoffset);
 				if (isLetter(rulechar, c)) // letter in rule matches that letter exactly, only.
 				{
 					// it's a letter, directly compare it to the input character
@@ -767,7 +2514,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 				}
 				else if (rulechar == ' ') // space matches one non-letter
 				{
-					if (!isLetter(inpchar,c))
+					if (!(feat[inpos+inpoffset] & A_LETTER))
 					{
 						// match
 						ruleoffset++;
@@ -779,60 +2526,10 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-				// The NRL rules have '#' match 'one or more vowels', while the SV rules have '#' match 'exactly one vowel'
-				// NRL rules also allow '##' to match 'two or more vowels' which requires look-ahead or a recursive parser
-				// which does a DFS or BFS of every potentially matching character. We cheat and look ahead here.
-#ifdef NRL_VOWEL
-				else if (rulechar == '#') // # matches one or more vowels
-				{
-					// special check here for the case where the rule has '##' in it
-					if ( (rparen_idx+ruleoffset+1 < equals_idx) && (ruleset.rule[i][rparen_idx+ruleoffset+1] == '#') ) // '##' case
-					{
-						e_printf(V_ERULES, "found a suffix rule with the problematic ## case\n");
-						// check for two vowels, plus any more.
-						if (isVowel(inpchar,c) && (inpos+inpoffset+1 <= input->elements) && isVowel(input->data[inpos+inpoffset+1],c))
-						{
-							// match 2 vowels...
-							ruleoffset += 2;
-							// yes, we recheck what we already just checked. this avoids a bad bug.
-							while ((inpos+inpoffset+1 <= input->elements) && isVowel(inpchar,c))
-							{
-								// match another...
-								inpoffset++;
-								inpchar = input->data[inpos+inpoffset];
-							}
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
-					}
-					else // '#' case
-					{
-						if (isVowel(inpchar,c))
-						{
-							// match one...
-							ruleoffset++;
-							// yes, we recheck what we already just checked. this avoids a bad bug.
-							while ((inpos+inpoffset+1 <= input->elements) && isVowel(inpchar,c))
-							{
-								// match another...
-								inpoffset++;
-								inpchar = input->data[inpos+inpoffset];
-							}
-						}
-						else
-						{
-							// mismatch
-							fail = true;
-						}
-					}
-				}
-#else
+				// the SV rules have '#' match exactly one vowel; see nrlMatchSide() for the NRL 'one or more vowels'
 				else if (rulechar == '#') // # matches one vowel
 				{
-					if (isVowel(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_VOWEL))
 					{
 						// match
 						ruleoffset++;
@@ -844,10 +2541,9 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-#endif
 				else if (rulechar == '.') // . matches one voiced consonant
 				{
-					if (isVoiced(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_VOICED))
 					{
 						// match
 						ruleoffset++;
@@ -864,7 +2560,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 				{
 					// the original code is buggy here, probably improperly copy-pasted from the prefix check code.
 #ifdef ORIGINAL_BUGS
-					if (isSibil(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_SIBIL))
 					{
 						// match
 						ruleoffset++;
@@ -899,7 +2595,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						ruleoffset++;
 						inpoffset += 2;
 					}
-					else if (isSibil(inpchar,c))
+					else if ((feat[inpos+inpoffset] & A_SIBIL))
 					{
 						// match
 						ruleoffset++;
@@ -917,7 +2613,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 				{
 #ifdef ORIGINAL_BUGS
 					// the original code is EXTREMELY BUGGY here: not only would it incorrectly check for 'HT' 'HC' and 'HS', but like the prefix version it forgets to increment the pointer and read the next byte, so it checks for 'H', then immediately checks that the 'H' is equal to 'T', 'C' or 'S', which will always fail! It also checks for isUaff BEFORE it checks for the 2 letter versions, which means it would never match 'TH' or 'SH' as it would match the 1-letter 'T' and 'S' first anyway!
-					if (isUaff(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_UAFF))
 					{
 						// match
 						ruleoffset++;
@@ -952,7 +2648,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						ruleoffset++;
 						inpoffset += 2;
 					}
-					else if (isUaff(inpchar,c))
+					else if ((feat[inpos+inpoffset] & A_UAFF))
 					{
 						// match 1 character
 						ruleoffset++;
@@ -967,7 +2663,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 				}
 				else if (rulechar == '^') // ^ matches one consonant
 				{
-					if (isCons(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_CONS))
 					{
 						// match
 						ruleoffset++;
@@ -996,7 +2692,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 				else if (rulechar == ':') // : matches zero or more consonants; this test can't fail, but it can consume consonants in the input
 				{
 					ruleoffset++;
-					while ((inpos+inpoffset+1 <= input->elements) && isCons(inpchar,c))
+					while ((inpos+inpoffset+1 <= input->elements) && (feat[inpos+inpoffset] & A_CONS))
 					{
 						inpoffset++;
 						inpchar = input->data[inpos+inpoffset];
@@ -1055,12 +2751,12 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 #ifdef SUPPORT_CONS1M
 				else if (rulechar == '*') // * matches one or more consonants
 				{
-					if (isCons(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_CONS))
 					{
 						// match one...
 						ruleoffset++;
 						// yes, we recheck what we already just checked. this avoids a bad bug.
-						while ((inpos+inpoffset+1 <= input->elements) && isCons(inpchar,c)) // TODO: there is a probable bug here with a string like " BANG" were NG are consonants but this while loops fails leaving the G unconsumed.
+						while ((inpos+inpoffset+1 <= input->elements) && (feat[inpos+inpoffset] & A_CONS)) // TODO: there is a probable bug here with a string like " BANG" were NG are consonants but this while loops fails leaving the G unconsumed.
 						{
 							// match another...
 							inpoffset++;
@@ -1080,7 +2776,7 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 #ifdef SUPPORT_CONS1EI
 				else if (rulechar == '$') // $ matches one consonant followed by 'E' or 'I'
 				{
-					if ( isCons(inpchar,c) && (inpos+inpoffset+1 <= input->elements)
+					if ( (feat[inpos+inpoffset] & A_CONS) && (inpos+inpoffset+1 <= input->elements)
 						&& ( (input->data[inpos+inpoffset+1] == 'E') // '^E' case
 							|| (input->data[inpos+inpoffset+1] == 'I') // '^I' case
 						)
@@ -1097,11 +2793,10 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 					}
 				}
 #endif
-#if (RULES_VERSION >= RULES_MACTALK)
 				// Mactalk and later has two extra rule characters: ? (single digit) and _ (zero or more digits)
-				else if (rulechar == '?') // ? matches any single digit
+				else if ((rulechar == '?') && (c.rules_version >= RULES_MACTALK)) // ? matches any single digit
 				{
-					if (isDigit(inpchar,c))
+					if ((feat[inpos+inpoffset] & A_DIGIT))
 					{
 						// match
 						ruleoffset++;
@@ -1113,92 +2808,175 @@ s32 processRule(const sym_ruleset const ruleset, const vec_char32* const input,
 						fail = true;
 					}
 				}
-				else if (rulechar == '_') // _ matches zero or more digits; this test can't fail, but it can consume digits in the input
+				else if ((rulechar == '_') && (c.rules_version >= RULES_MACTALK)) // _ matches zero or more digits; this test can't fail, but it can consume digits in the input
 				{
 					ruleoffset++;
-					while ((inpos+inpoffset+1 <= input->elements) && isDigit(inpchar,c))
+					while ((inpos+inpoffset+1 <= input->elements) && (feat[inpos+inpoffset] & A_DIGIT))
 					{
 						inpoffset++;
 						inpchar = input->data[inpos+inpoffset];
 					}
 				}
-#endif
 				else
 				{
-					e_printf(V_ERR, "got an invalid rule character of '%c'(0x%02x), exiting!\n", rulechar, rulechar);
-					exit(1);
+					e_printf(V_XLATE_ERR, "got an invalid rule character of '%c'(0x%02x)!\n", rulechar, rulechar);
+					return -3;
 				}
 			}
+#endif
+			if (prof) prof->suffix_ticks += profileTicks() - ticks;
 			if (fail) continue; // mismatch, move on to the next rule.
 		}
 
-		// if we got this far, dump the rule right hand side past the = sign to output, then
-		// consume the number of characters between the parentheses by returning inpos + that number
+		// if we got this far, the whole rule matched
+		return i;
+	}
+	// if we got here, we ran out of rules without finding a valid one
+	return -1;
+}
+
+// find the first rule of the ruleset which matches the input at inpos with the rule list's automaton; returns the rule
+// number, -1 if no rule matched, or -2 if the automaton can't be used for this lookup
+INTERNAL s32 matchRuleDfa(const sym_ruleset ruleset, const vec_u8* const input, const u32 inpos, s_cfg c)
+{
+	sym_dfa* const dfa = ruleset.dfa;
+	if (!dfa) return -2;
+	if (!dfa->built) buildRuleDfa(dfa, ruleset.crule, ruleset.num_rules, c);
+	if ((!dfa->ok) || (dfa->mactalk_symbols && (c.rules_version < RULES_MACTALK))) return -2;
+	u64* const right = dfa->acc_scratch + dfa->words;
+	u64* const left = right + dfa->words;
+	// the exact match part and suffix first, since most rules fail there; the prefix only needs to be run if it didn't
+	if (!runDfaSide(dfa, &dfa->side[0], input, inpos, right)) return -2;
+	bool any = false;
+	for (u32 w = 0; w < dfa->words; w++) any |= (right[w] != 0);
+	if (!any) return -1;
+	if (!runDfaSide(dfa, &dfa->side[1], input, (s32)inpos-1, left)) return -2;
+	for (u32 w = 0; w < dfa->words; w++)
+	{
+		u64 m = right[w] & left[w];
+		if (m)
 		{
-			// crude strcpy
-			e_printf(V_RULES, "%s\n",ruleset.rule[i]);
-			while (ruleset.rule[i][++equals_idx] != '\0')
+			u32 b = 0;
+			while (!(m & 1))
 			{
-				vec_char32_append(output, ruleset.rule[i][equals_idx]);
+				m >>= 1;
+				b++;
 			}
-			return inpos+(nbase-1); // we return nbase-1 since the processing loop increments inpos first thing it does
+			return (w<<6)+b;
+		}
+	}
+	return -1;
+}
+
+// append a character to the output; this fails if a caller's fixed size output buffer is full, or memory runs out
+INTERNAL reciter_status emitOutput(vec_u8* output, const u8 a)
+{
+	if (vec_u8_append(output, a)) return RECITER_OK;
+	return output->borrowed ? RECITER_E_OUTPUT_FULL : RECITER_E_NOMEM;
+}
+
+// append n characters to the output at once, e.g. the right hand side of a rule; fails as emitOutput does
+INTERNAL reciter_status emitOutputs(vec_u8* output, const u8* a, const u32 n)
+{
+	if (vec_u8_append_n(output, a, n)) return RECITER_OK;
+	return output->borrowed ? RECITER_E_OUTPUT_FULL : RECITER_E_NOMEM;
+}
+
+// translate the input at inpos with the first matching rule of the ruleset; returns the position of the last input
+// character the rule consumed, or a negated reciter_status if the translation can't go on
+INTERNAL s32 processRule(const sym_ruleset const ruleset, const vec_u8* const input, const u32 inpos, vec_u8* output, s_cfg c)
+{
+	c.stats->lookups[ruleset.symbol]++;
+	const u64 ticks = c.profile ? profileTicks() : 0;
+	s32 i = -2;
+	if (c.matcher != MATCHER_INTERP)
+	{
+		i = matchRuleDfa(ruleset, input, inpos, c);
+		if (i == -2) c.stats->dfa_fallbacks++;
+	}
+	if (c.matcher == MATCHER_CHECK)
+	{
+		// differential check: the interpretive matcher is the reference
+		const s32 j = matchRuleInterp(ruleset, input, inpos, c);
+		if ((i != -2) && (i != j))
+		{
+			e_printf(V_XLATE_ERR, "matcher mismatch at position %d: automaton found %s, interpreter found %s\n", inpos, (i < 0) ? "no rule" : ruleset.crule[i]->text, (j < 0) ? "no rule" : ruleset.crule[j]->text);
+			c.stats->mismatches++;
 		}
+		i = j;
+	}
+	else if (i == -2)
+	{
+		i = matchRuleInterp(ruleset, input, inpos, c);
+	}
+	if (c.profile)
+	{
+		c.profile->lookup_ticks[ruleset.symbol] += profileTicks() - ticks;
+		if (i >= 0) c.profile->rules[ruleset.symbol][i].matched++;
 	}
-	// did we break out with a valid rule?
-	if (i == ruleset.num_rules)
+	if (c.used_rules && (i >= 0)) logRule(c.used_rules, ruleset.symbol, i);
+	if (i == -3) return -RECITER_E_BAD_RULE;
+	if (i < 0)
 	{
-		e_printf(V_ERR, "unable to find any matching rule, exiting!\n");
-		exit(1);
+		e_printf(V_XLATE_ERR, "unable to find any matching rule at position %d!\n", inpos);
+		return -RECITER_E_NO_RULE;
 	}
-	// we should never get here.
-	e_printf(V_ERR, "something very bad happened, exiting!\n");
-	exit(1);
-	// we should especially never get here.
-	return inpos;
+	// dump the rule right hand side past the = sign to output, then
+	// consume the number of characters between the parentheses by returning inpos + that number
+	const sym_rule* const r = ruleset.crule[i];
+	t_printf(V_RULES, "%s\n", r->text);
+	const reciter_status status = c.phoneme_ids ? emitOutputs(output, r->output_ids, r->output_ids_len) : emitOutputs(output, (const u8*)r->output, r->output_len);
+	if (status != RECITER_OK) return -status;
+	return inpos+(r->match_len-1); // we return match_len-1 since the processing loop increments inpos first thing it does
 }
 
-void processPhrase(const sym_ruleset* const ruleset, const vec_char32* const input, vec_char32* output, s_cfg c)
+// translate the preprocessed phrase from position start up to position stop; stop must be a position processing would
+// land on (see isInputCut), or the end of the phrase
+INTERNAL reciter_status processPhrase(const sym_ruleset* const ruleset, const vec_u8* const input, const u32 start, const u32 stop, vec_u8* output, s_cfg c)
 {
-	e_printf(V_MAINLOOP, "processPhrase called, phrase has %d elements\n", input->elements);
-	s32 inpos = -1;
-	char32_t inptemp;
-	while (((inptemp = input->data[++inpos])||(1)) && (inptemp != RECITER_END_CHAR) && (inpos < input->elements))
+	t_printf(V_MAINLOOP, "processPhrase called, phrase has %d elements\n", input->elements);
+	s32 inpos = (s32)start-1;
+	u8 inptemp;
+	while (((inptemp = input->data[++inpos])||(1)) && (inptemp != RECITER_END_CHAR) && (inpos < input->elements) && (inpos < stop))
 	{
-		e_printf(V_MAINLOOP, "position is now %d (%c)\n", inpos, input->data[inpos]);
+		t_printf(V_MAINLOOP, "position is now %d (%c)\n", inpos, input->data[inpos]);
 		if (input->data[inpos] == '.') // is this character a period?
 		{
-			e_printf(V_MAINLOOP, "character is a period...\n");
+			t_printf(V_MAINLOOP, "character is a period...\n");
 			if (isDigit(input->data[++inpos], c)) // is the character after the period a digit? // TODO: verify there isn't a bug here with consuming an extra input item 
 			{
-				e_printf(V_MAINLOOP, " followed by a digit...\n");
+				t_printf(V_MAINLOOP, " followed by a digit...\n");
 				u8 inptemp_features = c.ascii_features[inptemp&0x7f]; // save features from initial character
 				if (isPunct(inptemp, c)) // if the initial character was punctuation
 				{
-					e_printf(V_MAINLOOP, " and the character before the period was a punctuation symbol!\n");
+					t_printf(V_MAINLOOP, " and the character before the period was a punctuation symbol!\n");
 					// look up PUNCT_DIGIT rules
 					inpos = processRule(ruleset[RULES_PUNCT_DIGIT], input, inpos, output, c);
+					if (inpos < 0) return -inpos;
 					// THIS CASE IS FINISHED
 				}
 				else
 				{
-					e_printf(V_MAINLOOP, " but the character before the period was not a punctuation symbol.\n");
+					t_printf(V_MAINLOOP, " but the character before the period was not a punctuation symbol.\n");
 					if (!inptemp_features) // if the feature was set to \0, then completely ignore this character.
 					{
 						//TODO(optional): original code clobbers the input string character with a space as well
-						vec_char32_append(output, ' '); // add a space to the output word.
+						const reciter_status status = emitOutput(output, c.phoneme_ids ? charPhonemeId(' ') : ' '); // add a space to the output word.
+						if (status != RECITER_OK) return status;
 						// THIS CASE IS FINISHED
 					}
 					else
 					{
-						if (inptemp_features&A_LETTER) // could be isLetter(inptemp);
+						if ((inptemp_features&A_LETTER) && (inptemp >= 'A') && (inptemp <= 'Z')) // could be isLetter(inptemp); bytes past 0x7f have the features of their low 7 bits, but no rule table
 						{
 							inpos = processRule(ruleset[inptemp-0x41], input, inpos, output, c);
+							if (inpos < 0) return -inpos;
 							// THIS CASE IS FINISHED
 						}
 						else
 						{
-							e_printf(V_ERR, "found a character that isn't punct/digit, nor letter, nor null, bail out!\n");
-							exit(1);
+							e_printf(V_XLATE_ERR, "found a character that isn't punct/digit, nor letter, nor null, bail out!\n");
+							return RECITER_E_BAD_INPUT;
 							// THIS CASE IS FINISHED
 						}
 					}
@@ -1206,1392 +2984,1693 @@ void processPhrase(const sym_ruleset* const ruleset, const vec_char32* const inp
 			}
 			else
 			{
-				e_printf(V_MAINLOOP, " but not followed by a digit, so treat it as a pause.\n");
-				vec_char32_append(output, '.'); // add a period to the output word.
+				t_printf(V_MAINLOOP, " but not followed by a digit, so treat it as a pause.\n");
+				const reciter_status status = emitOutput(output, c.phoneme_ids ? charPhonemeId('.') : '.'); // add a period to the output word.
+				if (status != RECITER_OK) return status;
 				// THIS CASE IS FINISHED
 			}
 		}
 		else
 		{
-			e_printf(V_MAINLOOP, "character is not a period...");
+			t_printf(V_MAINLOOP, "character is not a period...");
 			u8 inptemp_features = c.ascii_features[inptemp&0x7f]; // save features from initial character
 			if (isPunct(inptemp, c)) // if the initial character was punctuation
 			{
-				e_printf(V_MAINLOOP, " and the initial character was a punctuation symbol!\n");
+				t_printf(V_MAINLOOP, " and the initial character was a punctuation symbol!\n");
 				// look up PUNCT_DIGIT rules
 				inpos = processRule(ruleset[RULES_PUNCT_DIGIT], input, inpos, output, c);
+				if (inpos < 0) return -inpos;
 				// THIS CASE IS FINISHED
 			}
 			else
 			{
-				e_printf(V_MAINLOOP, " but the initial charater was not a punctuation symbol.\n");
+				t_printf(V_MAINLOOP, " but the initial charater was not a punctuation symbol.\n");
 				if (!inptemp_features) // if the feature was set to \0, then completely ignore this character.
 				{
 					//TODO(optional): original code clobbers the input string character with a space as well
-					vec_char32_append(output, ' '); // add a space to the output word.
+					const reciter_status status = emitOutput(output, c.phoneme_ids ? charPhonemeId(' ') : ' '); // add a space to the output word.
+					if (status != RECITER_OK) return status;
 					// THIS CASE IS FINISHED
 				}
 				else
 				{
-					if (inptemp_features&A_LETTER) // could be isLetter(inptemp);
+					if ((inptemp_features&A_LETTER) && (inptemp >= 'A') && (inptemp <= 'Z')) // could be isLetter(inptemp); bytes past 0x7f have the features of their low 7 bits, but no rule table
 					{
 						inpos = processRule(ruleset[inptemp-0x41], input, inpos, output, c);
+						if (inpos < 0) return -inpos;
 						// THIS CASE IS FINISHED
 					}
 					else
 					{
-						e_printf(V_ERR, "found a character that isn't punct/digit, nor letter, nor null, bail out!\n");
-						exit(1);
+						e_printf(V_XLATE_ERR, "found a character that isn't punct/digit, nor letter, nor null, bail out!\n");
+						return RECITER_E_BAD_INPUT;
 						// THIS CASE IS FINISHED
 					}
 				}
 			}
 		}
 	}
+	return RECITER_OK;
 }
 
-void usage()
+// input, either a file's contents, memory mapped or read into memory, or a stream (stdin or a pipe) which is read
+// as it arrives
+typedef struct input_file
 {
-	printf("Usage: executablename parameters\n");
-	printf("Brief explanation of function of executablename\n");
-	printf("\n");
-}
+	const u8* data;
+	size_t len;
+	size_t pos; // how much of data readInput has handed out
+	bool mapped;
+	bool stream;
+#ifdef USE_MMAP
+	int fd; // of the stream
+#endif
+} input_file;
 
-#define NUM_PARAMETERS 1
-
-int main(int argc, char **argv)
+INTERNAL bool openInputFile(const char* name, input_file* f, s_cfg c)
 {
-	s_cfg c =
-	{
-		{ // ascii_features rules set
-			0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // CTRL-@ thru CTRL-O
-			0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // CTRL-P thru CTRL+_
-			0, // SPACE
-			A_PUNCT, // !
-			A_PUNCT, // "
-			A_PUNCT, // #
-			A_PUNCT, // $
-			A_PUNCT, // %
-			A_PUNCT, // &
-			A_PUNCT|A_LETTER, // '
-			0, // (
-			0, // )
-			A_PUNCT, // *
-			A_PUNCT, // +
-			A_PUNCT, // ,
-			A_PUNCT, // -
-			A_PUNCT, // .
-			A_PUNCT, // /
-			A_DIGIT|A_PUNCT, // 0
-			A_DIGIT|A_PUNCT, // 1
-			A_DIGIT|A_PUNCT, // 2
-			A_DIGIT|A_PUNCT, // 3
-			A_DIGIT|A_PUNCT, // 4
-			A_DIGIT|A_PUNCT, // 5
-			A_DIGIT|A_PUNCT, // 6
-			A_DIGIT|A_PUNCT, // 7
-			A_DIGIT|A_PUNCT, // 8
-			A_DIGIT|A_PUNCT, // 9
-			A_PUNCT, // :
-			A_PUNCT, // ;
-			A_PUNCT, // <
-			A_PUNCT, // =
-			A_PUNCT, // >
-			A_PUNCT, // ?
-			A_PUNCT, // @
-			A_LETTER|A_VOWEL, // A
-			A_LETTER|A_CONS|A_VOICED, // B
-			A_LETTER|A_CONS|A_SIBIL, // C
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // D
-			A_LETTER|A_VOWEL, // E
-			A_LETTER|A_CONS, // F
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED, // G
-			A_LETTER|A_CONS, // H
-			A_LETTER|A_VOWEL, // I
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // J
-			A_LETTER|A_CONS, // K
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // L
-			A_LETTER|A_CONS|A_VOICED, // M
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // N
-			A_LETTER|A_VOWEL, // O
-			A_LETTER|A_CONS, // P
-			A_LETTER|A_CONS, // Q
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // R
-			A_LETTER|A_CONS|A_SIBIL|A_UAFF, // S
-			A_LETTER|A_CONS|A_UAFF, // T
-			A_LETTER|A_VOWEL, // U
-			A_LETTER|A_CONS|A_VOICED, // V
-			A_LETTER|A_CONS|A_VOICED, // W
-			A_LETTER|A_CONS|A_SIBIL, // X
-			A_LETTER|A_VOWEL, // Y
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // Z
-			0, // [
-			0, // '\'
-			0, // ]
-			A_PUNCT, // ^
-			0, // _
-			/// Technically, we can do a check for 0x60-0x7f and mirror it to 0x40-0x5f,
-			// but to make it so we can just do a simple validation of "is a valid ascii character <= 0x7f"
-			// and protect from out of bounds accesses using &0x7f; we repeat the 0x60-0x7f part here
-			A_PUNCT, // `
-			A_LETTER|A_VOWEL, // a
-			A_LETTER|A_CONS|A_VOICED, // b
-			A_LETTER|A_CONS|A_SIBIL, // c
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // d
-			A_LETTER|A_VOWEL, // e
-			A_LETTER|A_CONS, // f
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED, // g
-			A_LETTER|A_CONS, // h
-			A_LETTER|A_VOWEL, // i
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // j
-			A_LETTER|A_CONS, // k
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // l
-			A_LETTER|A_CONS|A_VOICED, // m
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // n
-			A_LETTER|A_VOWEL, // o
-			A_LETTER|A_CONS, // p
-			A_LETTER|A_CONS, // q
-			A_LETTER|A_CONS|A_VOICED|A_UAFF, // r
-			A_LETTER|A_CONS|A_SIBIL|A_UAFF, // s
-			A_LETTER|A_CONS|A_UAFF, // t
-			A_LETTER|A_VOWEL, // u
-			A_LETTER|A_CONS|A_VOICED, // v
-			A_LETTER|A_CONS|A_VOICED, // w
-			A_LETTER|A_CONS|A_SIBIL, // x
-			A_LETTER|A_VOWEL, // y
-			A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // z
-			0, // {
-			0, // |
-			0, // }
-			A_PUNCT, // ~
-			0 // DEL
-		},
-		//NULL, // letter to sound rules
-		32, // verbose (was 0)
-	};
-
-	//{
-		const char* const arule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_TRANSLATOR)
-			" [A.]=EH3Y. ",
-#else
-			" [A.]=EH4Y. ",
-#endif
-			"[A] =AH",
-			" [ARE] =AAR",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [AND] =AEND",
-			" [AS] =AEZ",
-			" [AT] =AET",
-			" [AN] =AEN",
-#endif
-#if (RULES_VERSION >= RULES_TRANSLATOR)
-			" [AM] =AEM",
-			" [AREN'T] =AA1RINT",
-			" [ABOVE]=AHBAH3V",
-			" [AROUND]=AHRAW3ND",
-			"[A]DAP=AX",
-			" [AVE.] =AE2VINUW",
+	memset(f, 0, sizeof(*f));
+	if (!strcmp(name, "-"))
+	{
+		f->stream = true;
+#ifdef USE_MMAP
+		f->fd = STDIN_FILENO;
 #endif
-			" [AR]O=AXR",
-#if (RULES_VERSION >= RULES_TRANSLATOR)
-			"[AR]#=EHR",
-			" ^[AS]#=EYS",
-#elif ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[AR]#=EH4R ", // extra space
-			" ^[AS]#=EY4S",
-#else
-			"[AR]#=EH4R",
-			" ^[AS]#=EY4S",
-#endif
-			"[A]WA=AX",
-#if (RULES_VERSION >= RULES_TRANSLATOR)
-			"[AW]=AO",
-			" :[ANY]=EH3NIY",
-#elif ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[AW]=AO5 ", // extra space
-			" :[ANY]=EH4NIY",
-#else
-			"[AW]=AO5",
-			" :[ANY]=EH4NIY",
-#endif
-			// WIP end point for translator
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[A]^+#=EY5 ", // extra space
-#else
-			"[A]^+#=EY5",
-#endif
-			"#:[ALLY]=ULIY",
-			" [AL]#=UL",
-			"[AGAIN]=AXGEH4N",
-			"#:[AG]E=IHJ",
-			"[A]^%=EY",
-			"[A]^+:#=AE",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" :[A]^+ =EY4 ", // extra space
-#else
-			" :[A]^+ =EY4",
-#endif
-			" [ARR]=AXR",
-			"[ARR]=AE4R",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[AR] =AA5R",
-			"[AR] =ER",
-#else
-			" ^[AR] =AA5R",
-#endif
-			"[AR]=AA5R",
-			"[AIR]=EH4R",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[AI]=EY4 ", // extra space
-			"[AY]=EY5 ", // extra space
-			"[AU]=AO4 ", // extra space
-#else
-			"[AI]=EY4",
-			"[AY]=EY5",
-			"[AU]=AO4",
-#endif
-			"#:[AL] =UL",
-			"#:[ALS] =ULZ",
-			"[ALK]=AO4K",
-			"[AL]^=AOL",
-			" :[ABLE]=EY4BUL",
-			"[ABLE]=AXBUL",
-			"[A]VO=EY4",
-			"[ANG]+=EY4NJ",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [AMIGA]=AHMIY5GAH",
-#endif
-			"[ATARI]=AHTAA4RIY",
-			"[A]TOM=AE",
-			"[A]TTI=AE",
-			" [AT] =AET",
-			" [A]T=AH",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[A]A=", // remove double characters (if this is the first one in a chain...)
-#endif
-			"[A]=AE",
-		};
-
-		const char* const brule_eng[] =
+		e_printf(V_PARSE,"D* Reading input from stdin\n");
+		return true;
+	}
+#ifdef USE_MMAP
+	int fd = open(name, O_RDONLY);
+	if (fd < 0)
+	{
+		e_printf(V_ERR,"E* Unable to open input file %s!\n", name);
+		return false;
+	}
+	struct stat st;
+	if (fstat(fd, &st) < 0)
+	{
+		e_printf(V_ERR,"E* Unable to get the size of input file %s!\n", name);
+		close(fd);
+		return false;
+	}
+	if (!S_ISREG(st.st_mode)) // a named pipe or a device, read it as it arrives
+	{
+		f->stream = true;
+		f->fd = fd;
+		e_printf(V_PARSE,"D* Reading input from %s as a stream\n", name);
+		return true;
+	}
+	f->len = st.st_size;
+	if (f->len) // mmap() refuses empty mappings
+	{
+		void* map = mmap(NULL, f->len, PROT_READ, MAP_PRIVATE, fd, 0);
+		if (map == MAP_FAILED)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[B]: = BIY4 ",
-#else
-			" [B] =BIY4",
-#endif
-			" [BE]^#=BIH",
-			"[BEING]=BIY4IHNX",
-			" [BOTH] =BOW4TH",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [BY] =BAY",
-			" [BUT] =BAHT",
-			" [BEEN] =BIHN",
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [BUS]#=BIH4Z ", // extra space
+			e_printf(V_ERR,"E* Unable to map input file %s!\n", name);
+			close(fd);
+			return false;
+		}
+		posix_madvise(map, f->len, POSIX_MADV_SEQUENTIAL);
+		f->data = map;
+		f->mapped = true;
+	}
+	close(fd);
+	e_printf(V_PARSE,"D* Successfully mapped %llu bytes\n", (unsigned long long)f->len);
+	return true;
 #else
-			" [BUS]#=BIH4Z",
-#endif
-			"[BREAK]=BREY5K",
-			"[BUIL]=BIH4L",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"B[B]=", // remove double characters (if this is the second one in a chain...)
+	FILE *in = fopen(name, "rb");
+	if (!in)
+	{
+		e_printf(V_ERR,"E* Unable to open input file %s!\n", name);
+		return false;
+	}
+	fseek(in, 0, SEEK_END);
+	f->len = ftell(in);
+	rewind(in); //fseek(in, 0, SEEK_SET);
+	u8* data = malloc(f->len ? f->len : 1);
+	if (data == NULL)
+	{
+		e_printf(V_ERR,"E* Failure to allocate memory for array of size %llu, aborting!\n", (unsigned long long)f->len);
+		fclose(in);
+		return false;
+	}
+	size_t temp = fread(data, sizeof(uint8_t), f->len, in);
+	fclose(in);
+	if (temp != f->len)
+	{
+		e_printf(V_ERR,"E* Error reading in %llu elements, only read in %llu, aborting!\n", (unsigned long long)f->len, (unsigned long long)temp);
+		free(data);
+		return false;
+	}
+	e_printf(V_PARSE,"D* Successfully read in %llu bytes\n", (unsigned long long)temp);
+	f->data = data;
+	return true;
 #endif
-			"[B]=B",
-		};
+}
 
-		const char* const crule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[C]: = SIY4 ",
-#else
-			" [C] =SIY4",
-#endif
-			" [CH]^=K",
-			"^E[CH]=K",
-			"[CHA]R#=KEH5",
-			"[CH]=CH",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" S[CI]#=SAY4 ", // extra space
-#else
-			" S[CI]#=SAY4",
-#endif
-			"[CI]A=SH",
-			"[CI]O=SH",
-			"[CI]EN=SH",
-			"[CITY]=SIHTIY",
-			"[C]+=S",
-			"[CK]=K",
-#if ((RULES_VERSION == RULES_C64) || defined(C64_ADDED_RULES))
-			"[COMMODORE]=KAA4MAHDOHR",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[COM]%=KAHM",
-#else
-			"[COM]=KAHM",
-#endif
-			"[CUIT]=KIHT",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[CREA]^+=KRIYEY4",
-			"[CC]=CH",
+INTERNAL void closeInputFile(input_file* f)
+{
+#ifdef USE_MMAP
+	if (f->mapped) munmap((void*)f->data, f->len);
+	if (f->stream && (f->fd != STDIN_FILENO)) close(f->fd);
 #else
-			"[CREA]=KRIYEY",
+	free((void*)f->data);
 #endif
-			"[C]=K",
-		};
+	memset(f, 0, sizeof(*f));
+}
 
-		const char* const drule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[D]: = DIY4 ",
-#else
-			" [D] =DIY4",
-#endif
-			" [DR.] =DAA4KTER",
-			"#:[DED] =DIHD",
-			".E[D] =D",
-			"#:^E[D] =T",
-			" [DE]^#=DIH",
-			" [DO] =DUW",
-			" [DOES]=DAHZ",
-			"[DONE] =DAH5N",
-			"[DOING]=DUW4IHNX",
-			" [DOW]=DAW",
-			"#[DU]A=JUW",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"#[DU]^#=JAX ", // extra space
+// read up to max bytes of input into buf; returns 0 at the end of the input. a stream returns whatever has arrived so
+// far rather than waiting for all of max, where read() is available.
+INTERNAL size_t readInput(input_file* f, u8* buf, const size_t max, s_cfg c)
+{
+	if (!f->stream)
+	{
+		size_t n = f->len - f->pos;
+		if (n > max) n = max;
+		memcpy(buf, &f->data[f->pos], n);
+		f->pos += n;
+		return n;
+	}
+#ifdef USE_MMAP
+	ssize_t n;
+	do
+	{
+		n = read(f->fd, buf, max);
+	} while ((n < 0) && (errno == EINTR));
+	if (n < 0)
+	{
+		e_printf(V_ERR,"E* Error reading input, treating it as the end of the input!\n");
+		return 0;
+	}
+	return n;
 #else
-			"#[DU]^#=JAX",
+	return fread(buf, sizeof(uint8_t), max, stdin);
 #endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"D[D]=", // remove double characters (if this is the second one in a chain...)
-#endif
-			"[D]=D",
-		};
+}
 
-		const char* const erule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [E] = IY4 ",
-#else
-			" [E] =IYIY4",
-#endif
-			"#:[E] =",
-			"':^[E] =",
-			" :[E] =IY",
-			"#[ED] =D",
-			"#:[E]D =",
-			"[EV]ER=EH4V",
-#if (RULES_VERSION >= RULES_MACTALK) // these added rules seem like they could be done better using the & suffix rule symbol, but probably can't be...
-			"#:[ERED] =ERD",
-			"#:[ERING]=ERIHNX",
-			"#:[EN] =EHN",
-			"#:[ENED] =EHND",
-			"#:[ENESS] =NEHS",
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[E]^%=IY4 ", // extra space
-#else
-			"[E]^%=IY4",
-#endif
-			"[ERI]#=IY4RIY",
-			"[ERI]=EH4RIH",
-			"#:[ER]#=ER",
-			"[ERROR]=EH4ROHR",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[ERAS]E=IHREY5S",
-#elif ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[ERASE]=IHREY5S ", // extra space
-#else
-			"[ERASE]=IHREY5S",
-#endif
-			"[ER]#=EHR",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"#:[ER] =ER",
-			"#:[ERS] =ERZ",
-#endif
-			"[ER]=ER",
-			" [EVEN]=IYVEHN",
-			"#:[E]W=",
-			"@[EW]=UW",
-			"[EW]=YUW",
-			"[E]O=IY",
-			"#:&[ES] =IHZ",
-			"#:[E]S =",
-			"#:[ELY] =LIY",
-			"#:[EMENT]=MEHNT",
-			"[EFUL]=FUHL",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[EE]=IY4 ", // extra space
-#else
-			"[EE]=IY4",
-#endif
-			"[EARN]=ER5N",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [EAR]^=ER5 ", // extra space
-#else
-			" [EAR]^=ER5",
-#endif
-			"[EAD]=EHD",
-			"#:[EA] =IYAX",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[EA]SU=EH5 ", // extra space
-			"[EA]=IY5 ", // extra space
-			"[EIGH]=EY4 ", // extra space
-			"[EI]=IY4 ", // extra space
-			" [EYE]=AY4 ", // extra space
-#else
-			"[EA]SU=EH5",
-			"[EA]=IY5",
-			"[EIGH]=EY4",
-			"[EI]=IY4",
-			" [EYE]=AY4",
-#endif
-			"[EY]=IY",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[EU]=YUW5 ", // extra space
-#else
-			"[EU]=YUW5",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[EQUAL]=IY5KWUL",
-#else
-			"[EQUAL]=IY4KWUL",
-#endif
-			"[E]=EH",
-		};
+// the input as preProcess would see it: position 0 is the leading space, position i is input byte i-1 folded to
+// upper case, and position len+1 is the terminating character. only for files, not streams.
+INTERNAL u8 inputChar(const input_file* f, const size_t pos)
+{
+	if (pos == 0) return ' ';
+	if (pos > f->len) return RECITER_END_CHAR;
+	return toupper(f->data[pos-1]);
+}
 
-		const char* const frule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[F]: = EH4F ",
-			" [FOR] =FOHR",
-			" [FROM] =FRAHM",
-#else
-			" [F] =EH4F",
-#endif
-			"[FUL]=FUHL",
-			"[FRIEND]=FREH5ND",
-			"[FATHER]=FAA4DHER",
-			"[F]F=", // remove double characters (if this is the first one in a chain...)
-			"[F]=F",
-		};
+// a character which no rule symbol can consume as part of a run (of consonants, vowels or digits), so each rule symbol
+// consumes at most one of them
+INTERNAL bool isInputBreak(const u8 in, s_cfg c)
+{
+	return !(c.ascii_features[in&0x7f]&(A_LETTER|A_DIGIT));
+}
 
-		const char* const grule_eng[] =
+// can the preprocessed input in data be cut right before data[0]? processing always lands on a character no rule
+// translates (a space, line break, or other character without any features, see processPhrase), since those are
+// translated on their own and no rule's exact match part spans one, unless a '.' right before it swallows it. the
+// terminating character is one of them too, but nothing after it is translated anyway.
+INTERNAL bool isInputCut(const u8* const data, s_cfg c)
+{
+	return (!c.ascii_features[data[0]&0x7f]) && (data[-1] != '.');
+}
+
+// word cache: the translations of recently seen words, so the rules only need to be run once for a word in a given
+// context instead of every time it appears. a word is a piece of input from one cut (see isInputCut) up to the next,
+// and its translation depends on no more than a few break characters of input on either side of it (see ruleReach),
+// so those are part of the key along with the word, and a cached translation is exactly what the rules would produce.
+// most rules can only see the characters the word is cut at; the few which can see further only widen the key of the words
+// they could match in. the least recently used entry is replaced when the cache is full.
+#define CACHE_NONE ((u32)~0)
+// words whose key (the word and its context) is longer than this are not cached
+#define CACHE_MAX_KEY 64
+
+// a rule which can see further around a word than most
+typedef struct cache_far_rule
+{
+	const sym_rule* rule;
+	u32 left;
+	u32 right;
+} cache_far_rule;
+
+typedef struct cache_entry
+{
+	u32 hash;
+	u32 chain; // next entry in the same hash bucket
+	u32 newer; // neighbouring entries in least recently used order
+	u32 older;
+	u32 key_len; // the word and its context
+	u32 word_start; // offset of the word in the key
+	u32 word_len;
+	u32 out_len;
+	u32 size; // allocated size of data
+	u8* data; // the key, followed by the translation
+} cache_entry;
+
+struct word_cache
+{
+	cache_entry* entries;
+	u32 capacity;
+	u32 used;
+	u32* buckets;
+	u32 mask; // number of buckets-1
+	u32 newest;
+	u32 oldest;
+	u32 reach_left; // number of break characters before and after a word which its translation can depend on, for
+	u32 reach_right; // most words
+	cache_far_rule* far; // the rules which can see further than that
+	u32 num_far;
+};
+
+// how many break characters (see isInputBreak) a rule can look at on either side of a word while translating it,
+// counting the ones it is cut at on either end. the only rule symbol which can consume a break character is ' ', along
+// with literal ones in the exact match part, and no symbol reads past the next break character, so a rule side which can
+// consume n break characters beyond the word reads up to the nth one, or the n+1th if it doesn't end with one. the exact
+// match part is compared up to the first mismatch, so it is read like the suffix, but it can only reach past the word
+// by matching a space at its end.
+INTERNAL void ruleReach(const sym_rule* const r, u32* left, u32* right, s_cfg c)
+{
+	u32 n = 0;
+	for (u32 k = 0; k < r->prefix_len; k++)
+	{
+		if (r->prefix[k] == ' ') n++;
+	}
+	if (r->prefix_len && (r->prefix[0] != ' ')) n++;
+	*left = n;
+	n = 0;
+	bool past = false;
+	for (u32 k = 0; k < r->match_len; k++)
+	{
+		if (r->match[k] == ' ') past = true;
+		if (past && isInputBreak(r->match[k], c)) n++;
+	}
+	for (u32 k = 0; k < r->suffix_len; k++)
+	{
+		if (r->suffix[k] == ' ') n++;
+	}
+	if (r->suffix_len ? (r->suffix[r->suffix_len-1] != ' ') : !isInputBreak(r->match[r->match_len-1], c)) n++;
+	*right = n;
+}
+
+// number of break characters of context a piece of input needs before and after it, so that no rule matched inside the
+// piece can read past its context: the furthest any rule of the ruleset can see on either side (see ruleReach). most
+// rules only see the break characters next to the word they translate, so this is just a word or two.
+INTERNAL void ruleContextBreaks(const sym_ruleset* const ruleset, u32* left, u32* right, s_cfg c)
+{
+	*left = 0;
+	*right = 0;
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[G]: = JIY4 ",
-#else
-			" [G] =JIY4",
-#endif
-			"[GIV]=GIH5V",
-			" [G]I^=G",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[GE]T=GEH5 ", // extra space
-			"SU[GGES]=GJEH4S ", // extra space
-#else
-			"[GE]T=GEH5",
-			"SU[GGES]=GJEH4S",
-#endif
-			"[GG]=G", // compress double characters to one (if there are two together)
-			" B#[G]=G",
-			"[G]+=J",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[GREAT]=GREY4T ", // extra space
-#else
-			"[GREAT]=GREY4T",
-#endif
-			"[GON]E=GAO5N",
-			"#[GH]=",
-			" [GN]=N",
-			"[G]=G",
-		};
-
-		const char* const hrule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[H]: = EY4CH ",
-			" [HAV]=/HAEV",
-			" [HAS] =/HAEZ",
-			" [HAD] =/HAED",
-#else
-			" [H] =EY4CH",
-			" [HAV]=/HAE6V",
-#endif
-			" [HERE]=/HIYR",
-			" [HOUR]=AW5ER",
-			"[HOW]=/HAW",
-			"[H]#=/H",
-			"[H]=",
-		};
-
-		const char* const irule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [IN] =IHN",
-			" [IBM] =AY5BIYEH5M",
-			" [IN]=IH4N",
-			"#:[I]NG=IH",
-			" [IS] =IHZ",
-			" [IF] =IHF",
-			" [INTO] =IH3NTUW",
-#else
-			" [IN]=IHN",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [I] = AY4 ",
-#elif ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [I] =AY4 ", // extra space; unlike the others, this one might not be a bug
-#else
-			" [I] =AY4",
-#endif
-			"[I] =AY",
-			"[IN]D=AY5N",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"SEM[I]=IY ", // extra space
-#else
-			"SEM[I]=IY",
-#endif
-			" ANT[I]=AY",
-			"[IER]=IYER",
-			"#:R[IED] =IYD",
-			"[IED] =AY5D",
-			"[IEN]=IYEHN",
-			"[IE]T=AY4EH",
-			"[I']=AY5",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" :[I]^%=AY5 ", // extra space
-#else
-			" :[I]^%=AY5",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[I]%=AY5",
-#else
-			" :[IE] =AY4",
-#endif
-			"[I]%=IY",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[IE]=IY4 ", // extra space
-#else
-			"[IE]=IY4",
-#endif
-			" [IDEA]=AYDIY5AH",
-			"[I]^+:#=IH",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"#:[I]^AL=IH",
-#endif
-			"[IR]#=AYR",
-			"[IZ]%=AYZ",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[IS]%=AY4Z",
-			"[I]D%=AY4",
-			"#:[ITY] =IHTIY",
-#else
-			"[IS]%=AYZ",
-#endif
-			"I^[I]^#=IH",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"+^[I]^+=AY ", // extra space
-#else
-			"+^[I]^+=AY",
-#endif
-			"#:^[I]^+=IH",
-#ifdef NEW_RULE_UIC
-			"^U[I]C=", // (. or ^ ?) removes the silent I in the words "JUICE" and "SLUICE"
-#endif
-			"[I]^+=AY",
-			"[IR]=ER",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[IGH]=AY4 ", // extra space
-			"[ILD]=AY5LD ", // extra space
-#else
-			"[IGH]=AY4",
-			"[ILD]=AY5LD",
-#endif
-			" [IGN]=IHGN",
-			"[IGN] =AY4N",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[IGN]^=AY4N ", // extra space
-#else
-			"[IGN]^=AY4N",
-#endif
-			"[IGN]%=AY4N",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"#:[IC] = IHK",
-			"[ICRO]=AY5KROW",
-#else
-			"[ICRO]=AY4KROH",
-#endif
-			"[IQUE]=IY4K",
-			"[I]=IH",
-		};
+			u32 l, r;
+			ruleReach(ruleset[t].crule[i], &l, &r, c);
+			if (l > *left) *left = l;
+			if (r > *right) *right = r;
+		}
+	}
+}
+
+INTERNAL void freeWordCache(word_cache* w)
+{
+	if (!w) return;
+	for (u32 i = 0; w->entries && (i < w->used); i++)
+	{
+		free(w->entries[i].data);
+	}
+	free(w->entries);
+	free(w->buckets);
+	free(w->far);
+	free(w);
+}
 
-		const char* const jrule_eng[] =
+// allocate a cache of up to capacity words for a ruleset; returns NULL if out of memory
+INTERNAL word_cache* allocWordCache(const sym_ruleset* const ruleset, const u32 capacity, s_cfg c)
+{
+	word_cache* w = calloc(1, sizeof(word_cache));
+	if (!w) return NULL;
+	u32 buckets = 1;
+	while ((buckets < capacity*2) && (buckets < (1<<30))) buckets <<= 1;
+	w->entries = calloc(capacity ? capacity : 1, sizeof(cache_entry));
+	w->buckets = malloc(buckets * sizeof(u32));
+	if ((!w->entries) || (!w->buckets))
+	{
+		freeWordCache(w);
+		return NULL;
+	}
+	memset(w->buckets, 0xff, buckets * sizeof(u32));
+	w->capacity = capacity;
+	w->mask = buckets - 1;
+	w->newest = CACHE_NONE;
+	w->oldest = CACHE_NONE;
+	// the reach of the rules which only see the spaces around a word, and a list of the others
+	u32 num_rules = 0;
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		num_rules += ruleset[t].num_rules;
+	}
+	w->far = malloc((num_rules ? num_rules : 1) * sizeof(cache_far_rule));
+	if (!w->far)
+	{
+		freeWordCache(w);
+		return NULL;
+	}
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		for (u32 i = 0; i < ruleset[t].num_rules; i++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[J]: = JEY4 ",
-			"J[J]=", // remove double characters
-#else
-			" [J] =JEY4",
-#endif
-			"[J]=J",
-		};
+			u32 left, right;
+			ruleReach(ruleset[t].crule[i], &left, &right, c);
+			if ((left > 1) || (right > 1))
+			{
+				cache_far_rule* const f = &w->far[w->num_far++];
+				f->rule = ruleset[t].crule[i];
+				f->left = left;
+				f->right = right;
+			}
+			else
+			{
+				if (left > w->reach_left) w->reach_left = left;
+				if (right > w->reach_right) w->reach_right = right;
+			}
+		}
+	}
+	return w;
+}
+
+INTERNAL void cacheUnlink(word_cache* w, const u32 i)
+{
+	cache_entry* const e = &w->entries[i];
+	if (e->newer != CACHE_NONE) w->entries[e->newer].older = e->older;
+	else w->newest = e->older;
+	if (e->older != CACHE_NONE) w->entries[e->older].newer = e->newer;
+	else w->oldest = e->newer;
+}
 
-		const char* const krule_eng[] =
+INTERNAL void cacheMakeNewest(word_cache* w, const u32 i)
+{
+	cache_entry* const e = &w->entries[i];
+	e->newer = CACHE_NONE;
+	e->older = w->newest;
+	if (w->newest != CACHE_NONE) w->entries[w->newest].newer = i;
+	else w->oldest = i;
+	w->newest = i;
+}
+
+// find the entry for a key, or CACHE_NONE
+INTERNAL u32 cacheFind(const word_cache* w, const u32 hash, const u8* key, const u32 key_len, const u32 word_start, const u32 word_len)
+{
+	for (u32 i = w->buckets[hash & w->mask]; i != CACHE_NONE; i = w->entries[i].chain)
+	{
+		const cache_entry* const e = &w->entries[i];
+		if ((e->hash == hash) && (e->key_len == key_len) && (e->word_start == word_start) && (e->word_len == word_len) && !memcmp(e->data, key, key_len)) return i;
+	}
+	return CACHE_NONE;
+}
+
+// add a translation, replacing the least recently used entry if the cache is full; if there isn't enough memory for it,
+// the translation just isn't cached
+INTERNAL void cacheInsert(word_cache* w, const u32 hash, const u8* key, const u32 key_len, const u32 word_start, const u32 word_len, const u8* out, const u32 out_len)
+{
+	if (!w->capacity) return;
+	u32 i;
+	if (w->used < w->capacity)
+	{
+		i = w->used++;
+	}
+	else
+	{
+		i = w->oldest;
+		cacheUnlink(w, i);
+		u32* link = &w->buckets[w->entries[i].hash & w->mask];
+		while ((*link != CACHE_NONE) && (*link != i)) link = &w->entries[*link].chain;
+		if (*link == i) *link = w->entries[i].chain;
+	}
+	cache_entry* const e = &w->entries[i];
+	e->key_len = 0; // matches no key, until it is filled in
+	if (key_len + out_len > e->size)
+	{
+		u8* data = realloc(e->data, key_len + out_len);
+		if (data)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[K]: = KEY4 ",
-#else
-			" [K] =KEY4",
-#endif
-			" [K]N=",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"K[K]=", // remove double characters (if this is the second one in a chain...)
-#endif
-			"[K]=K",
-		};
+			e->data = data;
+			e->size = key_len + out_len;
+		}
+	}
+	if (key_len + out_len <= e->size)
+	{
+		memcpy(e->data, key, key_len);
+		memcpy(&e->data[key_len], out, out_len);
+		e->hash = hash;
+		e->key_len = key_len;
+		e->word_start = word_start;
+		e->word_len = word_len;
+		e->out_len = out_len;
+		e->chain = w->buckets[hash & w->mask];
+		w->buckets[hash & w->mask] = i;
+	}
+	cacheMakeNewest(w, i);
+}
 
-		const char* const lrule_eng[] =
+// translate the preprocessed phrase from position start up to position stop like processPhrase does, a word at a time
+// through the word cache if there is one
+INTERNAL reciter_status processWords(const sym_ruleset* const ruleset, const vec_u8* const input, const u32 start, const u32 stop, vec_u8* output, s_cfg c)
+{
+	if (!classifyInput(input, c.features, c)) return RECITER_E_NOMEM;
+	word_cache* const w = c.cache;
+	if (!w) return processPhrase(ruleset, input, start, stop, output, c);
+	const u8* const data = input->data;
+	u32 s = start;
+	while (s < stop)
+	{
+		u32 e = s + 1;
+		while ((e < stop) && !isInputCut(&data[e], c)) e++;
+		// a terminating character ends the translation inside this word
+		const bool last = (memchr(&data[s], RECITER_END_CHAR, e - s) != NULL);
+		// the word and the context around it which its translation can depend on; words whose context reaches the
+		// edges of the phrase are translated as they are, since the matchers treat those specially
+		bool cacheable = (!last) && (s > 0) && isInputCut(&data[s], c) && (e + 1 < input->elements) && isInputCut(&data[e], c);
+		u32 reach_left = w->reach_left;
+		u32 reach_right = w->reach_right;
+		for (u32 f = 0; cacheable && (f < w->num_far); f++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[L]: = EH4L ",
-#else
-			" [L] =EH4L",
-#endif
-			"[LO]C#=LOW",
-			"L[L]=", // remove double characters (if this is the second one in a chain...)
-			"#:^[L]%=UL",
-			"[LEAD]=LIYD",
-			" [LAUGH]=LAE4F",
-			"[L]=L",
-		};
-
-		const char* const mrule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[M]: = EH4M ",
-#else
-			" [M] =EH4M",
-#endif
-			" [MR.] =MIH4STER",
-			" [MS.]=MIH5Z",
-			" [MRS.] =MIH4SIXZ",
-			"[MOV]=MUW4V",
-			"[MACHIN]=MAHSHIY5N",
-			"M[M]=", // remove double characters (if this is the second one in a chain...)
-			"[M]=M",
-		};
-
-		const char* const nrule_eng[] =
-		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[N]: = EH4N ",
-#else
-			" [N] =EH4N",
-#endif
-			"E[NG]+=NJ",
-			"[NG]R=NXG",
-			"[NG]#=NXG",
-			"[NGL]%=NXGUL",
-			"[NG]=NX",
-			"[NK]=NXK",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [NOW] =NAW4 ", // extra space
-#else
-			" [NOW] =NAW4",
-#endif
-			"N[N]=", // remove double characters (if this is the second one in a chain...)
-			"[NON]E=NAH4N",
-			"[N]=N",
-		};
+			// a rule can only see further if its exact match part, up to any space in it, is in the word
+			const cache_far_rule* const far = &w->far[f];
+			if ((far->left <= reach_left) && (far->right <= reach_right)) continue;
+			u32 len = 0;
+			while ((len < far->rule->match_len) && (far->rule->match[len] != ' ')) len++;
+			for (u32 p = s + 1; len && (p + len <= e); p++)
+			{
+				if (!memcmp(&data[p], far->rule->match, len))
+				{
+					if (far->left > reach_left) reach_left = far->left;
+					if (far->right > reach_right) reach_right = far->right;
+					break;
+				}
+			}
+		}
+		u32 lo = s;
+		for (u32 n = 1; cacheable && (n < reach_left); )
+		{
+			if (lo <= 1) cacheable = false;
+			else if (isInputBreak(data[--lo], c)) n++;
+		}
+		u32 hi = e;
+		for (u32 n = 1; cacheable && (n < reach_right); )
+		{
+			if (hi + 2 >= input->elements) cacheable = false;
+			else if (isInputBreak(data[++hi], c)) n++;
+		}
+		if (cacheable && (hi + 1 - lo > CACHE_MAX_KEY)) cacheable = false;
+		if (!cacheable)
+		{
+			const reciter_status status = processPhrase(ruleset, input, s, e, output, c);
+			if ((status != RECITER_OK) || last) return status;
+			s = e;
+			continue;
+		}
+		const u32 key_len = hi + 1 - lo;
+		const u32 hash = hashBytes(&data[lo], key_len) + (s - lo);
+		const u32 i = cacheFind(w, hash, &data[lo], key_len, s - lo, e - s);
+		if (i != CACHE_NONE)
+		{
+			const cache_entry* const ent = &w->entries[i];
+			const reciter_status status = emitOutputs(output, &ent->data[key_len], ent->out_len);
+			if (status != RECITER_OK) return status;
+			cacheUnlink(w, i);
+			cacheMakeNewest(w, i);
+			c.stats->cache_hits++;
+		}
+		else
+		{
+			const u32 before = output->elements;
+			const reciter_status status = processPhrase(ruleset, input, s, e, output, c);
+			if (status != RECITER_OK) return status;
+			cacheInsert(w, hash, &data[lo], key_len, s - lo, e - s, &output->data[before], output->elements - before);
+			c.stats->cache_misses++;
+		}
+		s = e;
+	}
+	return RECITER_OK;
+}
+
+// buffered writer for the translation: the output is collected in a large buffer and written out with a single write
+// per flush, rather than going through stdio a character at a time
+#define OUTPUT_BUFFER_SIZE (1<<16)
+typedef struct output_writer
+{
+	FILE* f;
+	u8* buf;
+	u32 len;
+	bool ok; // false once a write failed
+	s_stats* stats; // output_bytes and output_writes are counted here, if set
+} output_writer;
+
+INTERNAL bool outputOpen(output_writer* w, FILE* f, s_stats* stats)
+{
+	w->f = f;
+	w->buf = malloc(OUTPUT_BUFFER_SIZE);
+	w->len = 0;
+	w->ok = (w->buf != NULL);
+	w->stats = stats;
+	return w->ok;
+}
 
-		const char* const orule_eng[] =
+// write n bytes straight to the file
+INTERNAL void outputWriteThrough(output_writer* w, const u8* data, size_t n)
+{
+	if (!n) return;
+	if (w->stats)
+	{
+		w->stats->output_bytes += n;
+		w->stats->output_writes++;
+	}
+#ifdef USE_MMAP
+	// anything stdio still holds for the file has to go first
+	fflush(w->f);
+	const int fd = fileno(w->f);
+	while (w->ok && n)
+	{
+		const ssize_t done = write(fd, data, n);
+		if ((done < 0) && (errno == EINTR)) continue;
+		if (done <= 0) w->ok = false;
+		else
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [O] = OW4 ",
-#else
-			" [O] =OH4W",
-#endif
-			"[OF] =AHV",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [ON] =AAN",
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [OH] =OW5 ", // extra space
-#else
-			" [OH] =OW5",
-#endif
-			"[OROUGH]=ER4OW",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [OR] =OHR",
-			"[OR] =ER",
-#else
-			"#:[OR] =ER", // ?
-#endif
-			"#:[ORS] =ERZ",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[OR]=OHR",
-#else
-			"[OR]=AOR",
-#endif
-			" [ONE]=WAHN",
-			"#[ONE] =WAHN",
-			"[OW]=OW",
-			" [OVER]=OW5VER",
-			"PR[O]V=UW4",
-			"[OV]=AH4V",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[O]^%=OW5 ", // extra space
-#else
-			"[O]^%=OW5",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[O]^EN=OW4",
-#else
-			"[O]^EN=OW",
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[O]^I#=OW5 ", // extra space
-#else
-			"[O]^I#=OW5",
-#endif
-			"[OL]D=OW4L",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OUGHT]=AO5T ", // extra space
-#else
-			"[OUGHT]=AO5T",
-#endif
-			"[OUGH]=AH5F",
-			" [OU]=AW",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"H[OU]S#=AW4 ", // extra space
-#else
-			"H[OU]S#=AW4",
-#endif
-			"[OUS]=AXS",
-			"[OUR]=OHR",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OULD]=UH5D ", // extra space
-#else
-			"[OULD]=UH5D",
-#endif
-			// this next rule is supposed to be "^[OU]^L=AH5" but this rule was missing the leading ^ in the IEEE version of the NRL paper due to a printing error (but is correct in the original NRL paper), and the error seems to have propagated to all official versions of RECITER as well. It is fixed in MACTALK and later.
-#if ((RULES_VERSION >= RULES_MACTALK) || defined(FIX_IEEE_ERROR))
-			"^[OU]^L=AH5",
-#elif ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OU]^L=AH5 ", // extra space, and mistake, see above
-#else
-			"[OU]^L=AH5", // mistake, see above
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OUP]=UW5P ", // extra space
-#else
-			"[OUP]=UW5P",
-#endif
-			"[OU]=AW",
-			"[OY]=OY",
-			"[OING]=OW4IHNX",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OI]=OY5 ", // extra space
-#else
-			"[OI]=OY5",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[OOR]=UH5R",
-#else
-			"[OOR]=OH5R", // unclear whether this is a mistake or not?
-#endif
-			"[OOK]=UH5K",
-			"F[OOD]=UW5D",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"L[OOD]=AH5D ", // extra space
-#else
-			"L[OOD]=AH5D",
-#endif
-			"M[OOD]=UW5D",
-			"[OOD]=UH5D",
-			"F[OOT]=UH5T",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OO]=UW5 ", // extra space
-#else
-			"[OO]=UW5",
-#endif
-			"[O']=OH",
-			"[O]E=OW",
-			"[O] =OW",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[OA]=OW4 ", // extra space
-#else
-			"[OA]=OW4",
-#endif
-			" [ONLY]=OW4NLIY",
-			" [ONCE]=WAH4NS",
-			"[ON'T]=OW4NT",
-			"C[O]N=AA",
-			"[O]NG=AO",
-			" :^[O]N=AH",
-			"I[ON]=UN",
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			"#:[ON]=UN", // missing a space before =
-#else
-			"#:[ON] =UN",
-#endif
-			"#^[ON]=UN",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"FR[O]ST=AO4",
-			"L[O]ST=AO4",
-			"C[O]ST=AO4",
-			"[O]ST%=OW4",
-			"[O]ST =OW5",
-#elif ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			"[O]ST=OW", // missing a space before =
-#else
-			"[O]ST =OW",
-#endif
-			"[OF]^=AO4F",
-			"[OTHER]=AH5DHER",
-			"R[O]B=RAA",
-#if (RULES_VERSION >= RULES_APPLE)
-			"PR[O]:#=ROW5", // This seems like an intentional change to make "PRODOS" pronounced slightly better
+			data += done;
+			n -= done;
+		}
+	}
 #else
-			"^R[O]:#=OW5",
+	if (fwrite(data, sizeof(uint8_t), n, w->f) != n) w->ok = false;
+	fflush(w->f);
 #endif
-			"[OSS] =AO5S",
-			"#:^[OM]=AHM",
-			"[O]=AA",
-		};
+}
 
-		const char* const prule_eng[] =
+INTERNAL bool outputFlush(output_writer* w)
+{
+	outputWriteThrough(w, w->buf, w->len);
+	w->len = 0;
+	return w->ok;
+}
+
+// append n bytes to the buffer; output which doesn't fit in an empty buffer is written straight through
+INTERNAL bool outputWrite(output_writer* w, const u8* data, const size_t n)
+{
+	if (w->len + n > OUTPUT_BUFFER_SIZE) outputFlush(w);
+	if (n > OUTPUT_BUFFER_SIZE) outputWriteThrough(w, data, n);
+	else
+	{
+		memcpy(&w->buf[w->len], data, n);
+		w->len += n;
+	}
+	return w->ok;
+}
+
+INTERNAL bool outputClose(output_writer* w)
+{
+	if (w->buf) outputFlush(w);
+	free(w->buf);
+	w->buf = NULL;
+	return w->ok;
+}
+
+// translate the whole input, as it is read. the input is preprocessed into a buffer a block of up to RECITER_CHUNK
+// bytes at a time, and translated in pieces, each as soon as enough context after it has been read (see
+// ruleContextBreaks), so the rules match exactly as they would on the whole input. the buffer only keeps the context
+// before the next piece and what has been read after it, so its size doesn't depend on the size of the input. the
+// pieces are cut at spaces and the like (see isInputCut). if out is set, the output of each piece is written to it as soon as it is
+// translated, otherwise it is collected in output; out is flushed after each piece of a stream, so the translation of
+// what has arrived so far shows up right away, and otherwise only when its buffer fills up.
+INTERNAL bool translateInput(const sym_ruleset* const ruleset, input_file* f, vec_u8* output, output_writer* out, s_cfg c)
+{
+	u32 breaks_left, breaks_right;
+	ruleContextBreaks(ruleset, &breaks_left, &breaks_right, c);
+	// buf->data[i] holds position base+i of the preprocessed input
+	vec_u8* buf = vec_u8_alloc(RECITER_CHUNK*2 + RECITER_PAD);
+	vec_u8* features = vec_u8_alloc(RECITER_CHUNK*2 + RECITER_PAD);
+	c.features = features;
+	bool ok = (buf->data != NULL) && (features->data != NULL);
+	size_t base = 0;
+	size_t start = 0; // the next position to translate
+	size_t keep = 0; // the first position the context of start needs
+	bool eof = false;
+	bool done = !ok;
+	if (ok) buf->data[buf->elements++] = ' ';
+	while (!done)
+	{
+		// make room for another block, dropping what is no longer needed first
+		if (buf->capacity - buf->elements < RECITER_CHUNK + 1 + RECITER_PAD)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[P]: = PIY4 ",
-#else
-			" [P] =PIY4",
-#endif
-			"[PH]=F",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[PEOPL]=PIY5PUL ", // extra space
-			"[POW]=PAW4 ", // extra space
+			memmove(buf->data, &buf->data[keep - base], buf->elements - (keep - base));
+			buf->elements -= keep - base;
+			base = keep;
+		}
+		const size_t need = buf->elements + RECITER_CHUNK + 1 + RECITER_PAD;
+		if (need > 0x7fffffff)
+		{
+			e_printf(V_ERR,"E* Unable to find a place to split the input near offset %llu, aborting!\n", (unsigned long long)start);
+			ok = false;
+			break;
+		}
+		if (need > buf->capacity)
+		{
+			vec_u8_resize(buf, need + RECITER_CHUNK);
+			if (need > buf->capacity)
+			{
+				e_printf(V_ERR,"E* Failure to allocate memory for array of size %llu, aborting!\n", (unsigned long long)need);
+				ok = false;
+				break;
+			}
+		}
+		// read and preprocess it
+		u8* const block = &buf->data[buf->elements];
+		const size_t n = readInput(f, block, RECITER_CHUNK, c);
+		for (size_t i = 0; i < n; i++)
+		{
+			block[i] = toupper(block[i]);
+		}
+		buf->elements += n;
+		c.stats->input_bytes += n;
+		if (!n)
+		{
+			eof = true;
+			buf->data[buf->elements++] = RECITER_END_CHAR;
+			memset(&buf->data[buf->elements], 0, RECITER_PAD);
+		}
+		const size_t end = base + buf->elements;
+		// a piece can stop at any cut up to limit, there's enough context after that; at the end of the input there is
+		// nothing more to wait for, so the rest of it is the last piece
+		size_t limit = end;
+		if (!eof)
+		{
+			u32 found = 0;
+			while ((limit > start + 1) && (found < breaks_right))
+			{
+				if (isInputBreak(buf->data[--limit - base], c)) found++;
+			}
+			if (found < breaks_right) continue;
+			while ((limit > start + 1) && !isInputCut(&buf->data[limit - base], c)) limit--;
+			if (limit == start + 1) continue;
+		}
+		const size_t stop = limit;
+		// the context after the piece; a terminating character inside the input ends the translation there, just like at
+		// the real end
+		size_t right = stop;
+		for (u32 found = 0; (right < end) && (found < breaks_right); right++)
+		{
+			if (isInputBreak(buf->data[right - base], c)) found++;
+		}
+		if (memchr(&buf->data[start - base], RECITER_END_CHAR, stop - start)) done = true;
+		// translate it in place; if the context stops short of the end of what has been read, the matchers never reach
+		// what follows it
+		vec_u8 window = { right - keep, right - keep, &buf->data[keep - base], false };
+		if (out) output->elements = 0;
+		const reciter_status status = processWords(ruleset, &window, start - keep, stop - keep, output, c);
+		if (status != RECITER_OK)
+		{
+			e_printf(V_ERR,"E* Unable to translate the input near offset %llu: %s, aborting!\n", (unsigned long long)start, reciter_strerror(status));
+			ok = false;
+			break;
+		}
+		if (out)
+		{
+			if (!outputWrite(out, output->data, output->elements) || (f->stream && !outputFlush(out)))
+			{
+				e_printf(V_ERR,"E* Error writing the output, aborting!\n");
+				ok = false;
+				break;
+			}
+		}
+		start = stop;
+		if (stop == end) break;
+		// the context before the next piece
+		keep = start;
+		for (u32 found = 0; (keep > base) && (found < breaks_left); keep--)
+		{
+			if (isInputBreak(buf->data[keep - 1 - base], c)) found++;
+		}
+	}
+	vec_u8_free(features);
+	vec_u8_free(buf);
+	return ok;
+}
+
+// the default configuration: the character feature table, and the defaults of the command line options
+static const s_cfg default_cfg =
+{
+	{ // ascii_features rules set
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // CTRL-@ thru CTRL-O
+		0,0,0,0,0,0,0,0,0,0,0,0,0,0,0,0, // CTRL-P thru CTRL+_
+		0, // SPACE
+		A_PUNCT, // !
+		A_PUNCT, // "
+		A_PUNCT, // #
+		A_PUNCT, // $
+		A_PUNCT, // %
+		A_PUNCT, // &
+		A_PUNCT|A_LETTER, // '
+		0, // (
+		0, // )
+		A_PUNCT, // *
+		A_PUNCT, // +
+		A_PUNCT, // ,
+		A_PUNCT, // -
+		A_PUNCT, // .
+		A_PUNCT, // /
+		A_DIGIT|A_PUNCT, // 0
+		A_DIGIT|A_PUNCT, // 1
+		A_DIGIT|A_PUNCT, // 2
+		A_DIGIT|A_PUNCT, // 3
+		A_DIGIT|A_PUNCT, // 4
+		A_DIGIT|A_PUNCT, // 5
+		A_DIGIT|A_PUNCT, // 6
+		A_DIGIT|A_PUNCT, // 7
+		A_DIGIT|A_PUNCT, // 8
+		A_DIGIT|A_PUNCT, // 9
+		A_PUNCT, // :
+		A_PUNCT, // ;
+		A_PUNCT, // <
+		A_PUNCT, // =
+		A_PUNCT, // >
+		A_PUNCT, // ?
+		A_PUNCT, // @
+		A_LETTER|A_VOWEL, // A
+		A_LETTER|A_CONS|A_VOICED, // B
+		A_LETTER|A_CONS|A_SIBIL, // C
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // D
+		A_LETTER|A_VOWEL, // E
+		A_LETTER|A_CONS, // F
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED, // G
+		A_LETTER|A_CONS, // H
+		A_LETTER|A_VOWEL, // I
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // J
+		A_LETTER|A_CONS, // K
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // L
+		A_LETTER|A_CONS|A_VOICED, // M
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // N
+		A_LETTER|A_VOWEL, // O
+		A_LETTER|A_CONS, // P
+		A_LETTER|A_CONS, // Q
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // R
+		A_LETTER|A_CONS|A_SIBIL|A_UAFF, // S
+		A_LETTER|A_CONS|A_UAFF, // T
+		A_LETTER|A_VOWEL, // U
+		A_LETTER|A_CONS|A_VOICED, // V
+		A_LETTER|A_CONS|A_VOICED, // W
+		A_LETTER|A_CONS|A_SIBIL, // X
+		A_LETTER|A_VOWEL, // Y
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // Z
+		0, // [
+		0, // '\'
+		0, // ]
+		A_PUNCT, // ^
+		0, // _
+		/// Technically, we can do a check for 0x60-0x7f and mirror it to 0x40-0x5f,
+		// but to make it so we can just do a simple validation of "is a valid ascii character <= 0x7f"
+		// and protect from out of bounds accesses using &0x7f; we repeat the 0x60-0x7f part here
+		A_PUNCT, // `
+		A_LETTER|A_VOWEL, // a
+		A_LETTER|A_CONS|A_VOICED, // b
+		A_LETTER|A_CONS|A_SIBIL, // c
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // d
+		A_LETTER|A_VOWEL, // e
+		A_LETTER|A_CONS, // f
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED, // g
+		A_LETTER|A_CONS, // h
+		A_LETTER|A_VOWEL, // i
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // j
+		A_LETTER|A_CONS, // k
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // l
+		A_LETTER|A_CONS|A_VOICED, // m
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // n
+		A_LETTER|A_VOWEL, // o
+		A_LETTER|A_CONS, // p
+		A_LETTER|A_CONS, // q
+		A_LETTER|A_CONS|A_VOICED|A_UAFF, // r
+		A_LETTER|A_CONS|A_SIBIL|A_UAFF, // s
+		A_LETTER|A_CONS|A_UAFF, // t
+		A_LETTER|A_VOWEL, // u
+		A_LETTER|A_CONS|A_VOICED, // v
+		A_LETTER|A_CONS|A_VOICED, // w
+		A_LETTER|A_CONS|A_SIBIL, // x
+		A_LETTER|A_VOWEL, // y
+		A_LETTER|A_CONS|A_SIBIL|A_VOICED|A_UAFF, // z
+		0, // {
+		0, // |
+		0, // }
+		A_PUNCT, // ~
+		0 // DEL
+	},
+	//NULL, // letter to sound rules
+#ifdef RECITER_RELEASE
+	0, // verbose
 #else
-			"[PEOPL]=PIY5PUL",
-			"[POW]=PAW4",
-#endif
-			"[PUT] =PUHT",
-			"[P]P=", // remove double characters (if this is the first one in a chain...)
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			// missing the preceding space, to force these to only start at the beginning of a word
-			"[P]S=",
-			"[P]N=",
-			"[PROF.]=PROHFEH4SER",
+	32, // verbose (was 0)
+#endif
+	RULES_DEFAULT, // rules_version
+	true, // use_index
+	MATCHER_INTERP, // matcher
+	NULL, // stats
+	NULL, // cache
+	NULL, // profile
+	NULL, // used_rules
+	NULL, // features
+	false, // phoneme_ids
+	true, // report_errors
+};
+
+// library interface, see reciter.h
+
+struct reciter_ctx
+{
+	const rule_handle* rules; // the selected ruleset variant, in a library shared with any other contexts
+	rule_tables tables; // its rule tables, with automata of this context's own
+	const sym_ruleset* ruleset; // tables.ruleset
+	s_cfg c;
+	s_stats stats;
+	vec_u8* phrase; // preprocessed input, kept between calls
+};
+
+// set up a context for a ruleset variant of a rule library, with the options of the configuration c, and a word cache
+// of cache_words words if that isn't 0. nothing is compiled, so this is cheap; the library has to outlive the context.
+INTERNAL reciter_status initContext(reciter_ctx* r, const rule_handle* handle, const s_cfg* const c, const u32 cache_words)
+{
+	memset(r, 0, sizeof(reciter_ctx));
+	// the feature table is const, so the configuration can only be copied in as a whole
+	memcpy(&r->c, c, sizeof(s_cfg));
+	r->c.stats = &r->stats;
+	r->c.cache = NULL;
+	r->c.profile = NULL;
+	r->c.used_rules = NULL;
+	r->phrase = vec_u8_alloc(256);
+	r->c.features = vec_u8_alloc(256);
+	r->rules = handle;
+	initRuleTables(&r->tables, handle);
+	r->ruleset = r->tables.ruleset;
+	r->c.rules_version = handle->variant->version;
+	if ((!r->phrase->data) || (!r->c.features->data)) return RECITER_E_NOMEM;
+	if (cache_words)
+	{
+		r->c.cache = allocWordCache(r->ruleset, cache_words, r->c);
+		if (!r->c.cache) return RECITER_E_NOMEM;
+	}
+	return RECITER_OK;
+}
+
+INTERNAL void freeContext(reciter_ctx* r)
+{
+	freeWordCache(r->c.cache);
+	freeRuleProfile(r->c.profile);
+	if (r->phrase) vec_u8_free(r->phrase);
+	if (r->c.features) vec_u8_free(r->c.features);
+	freeRuleTables(&r->tables);
+	memset(r, 0, sizeof(reciter_ctx));
+}
+
+// translate len bytes of input as a phrase of its own, appending the translation to output
+INTERNAL reciter_status translateText(reciter_ctx* ctx, const u8* in, const size_t len, vec_u8* output)
+{
+	if (len > 0x7fffffff - (2 + RECITER_PAD)) return RECITER_E_TOO_LONG;
+	// room for the leading space, the input, the terminating character and the padding
+	const u32 need = len + 2 + RECITER_PAD;
+	vec_u8* const phrase = ctx->phrase;
+	if (need > phrase->capacity)
+	{
+		vec_u8_resize(phrase, need);
+		if (need > phrase->capacity) return RECITER_E_NOMEM;
+	}
+	memcpy(&phrase->data[1], in, len);
+	phrase->elements = len + 1;
+	preProcess(phrase, ctx->c);
+	return processWords(ctx->ruleset, phrase, 0, phrase->elements, output, ctx->c);
+}
+
+reciter_status reciter_library_create(reciter_library** lib)
+{
+	if (!lib) return RECITER_E_ARG;
+	*lib = malloc(sizeof(rule_library));
+	if (!*lib) return RECITER_E_NOMEM;
+	const char* malformed;
+	if (!initRuleLibrary(*lib, &malformed))
+	{
+		reciter_library_destroy(*lib);
+		*lib = NULL;
+		return malformed ? RECITER_E_BAD_RULE : RECITER_E_NOMEM;
+	}
+	return RECITER_OK;
+}
+
+void reciter_library_destroy(reciter_library* lib)
+{
+	if (!lib) return;
+	freeRuleLibrary(lib);
+	free(lib);
+}
+
+reciter_status reciter_find_rules(const reciter_library* lib, const char* spec, const reciter_rules** rules)
+{
+	if ((!lib) || (!rules)) return RECITER_E_ARG;
+	*rules = NULL;
+	u32 rules_version = RULES_DEFAULT;
+	u32 rules_flags = RULES_FLAGS_DEFAULT;
+	if (spec && !parseRuleSpec(spec, &rules_version, &rules_flags)) return RECITER_E_ARG;
+	*rules = findRuleHandle(lib, rules_version, rules_flags);
+	return RECITER_OK;
+}
+
+reciter_status reciter_create(const reciter_rules* rules, reciter_ctx** ctx)
+{
+	if (!ctx) return RECITER_E_ARG;
+	*ctx = NULL;
+	if (!rules) return RECITER_E_ARG;
+	reciter_ctx* r = malloc(sizeof(reciter_ctx));
+	if (!r) return RECITER_E_NOMEM;
+	s_cfg c = default_cfg;
+	c.verbose = 0;
+	c.report_errors = false;
+	const reciter_status status = initContext(r, rules, &c, 0);
+	if (status != RECITER_OK)
+	{
+		reciter_destroy(r);
+		return status;
+	}
+	*ctx = r;
+	return RECITER_OK;
+}
+
+void reciter_destroy(reciter_ctx* ctx)
+{
+	if (!ctx) return;
+	freeContext(ctx);
+	free(ctx);
+}
+
+reciter_status reciter_set_cache(reciter_ctx* ctx, size_t words)
+{
+	if ((!ctx) || (words > 0x7fffffff)) return RECITER_E_ARG;
+	word_cache* cache = NULL;
+	if (words)
+	{
+		cache = allocWordCache(ctx->ruleset, words, ctx->c);
+		if (!cache) return RECITER_E_NOMEM;
+	}
+	freeWordCache(ctx->c.cache);
+	ctx->c.cache = cache;
+	return RECITER_OK;
+}
+
+reciter_status reciter_translate(reciter_ctx* ctx, const char* in, size_t len, char* out, size_t cap, size_t* out_len)
+{
+	if (out_len) *out_len = 0;
+	if ((!ctx) || (!in && len) || (!out && cap)) return RECITER_E_ARG;
+	// the output goes straight into the caller's buffer
+	vec_u8 output = { 0, (cap > 0xffffffff) ? 0xffffffff : cap, (u8*)out, true };
+	const reciter_status status = translateText(ctx, (const u8*)in, len, &output);
+	if (out_len) *out_len = output.elements;
+	return status;
+}
+
+const char* reciter_strerror(reciter_status status)
+{
+	switch (status)
+	{
+		case RECITER_OK: return "success";
+		case RECITER_E_ARG: return "invalid argument";
+		case RECITER_E_NOMEM: return "out of memory";
+		case RECITER_E_TOO_LONG: return "input too long";
+		case RECITER_E_OUTPUT_FULL: return "output buffer full";
+		case RECITER_E_NO_RULE: return "no rule matches the input";
+		case RECITER_E_BAD_RULE: return "invalid character in a rule";
+		case RECITER_E_BAD_INPUT: return "invalid character in the input";
+	}
+	return "unknown error";
+}
+
+#ifndef RECITER_NO_MAIN
+
+// monotonic wall clock time in seconds, for timing batch translation
+double nowSeconds()
+{
+#ifdef USE_MONOTONIC_CLOCK
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
 #else
-			// the apple version has these two next rules in the opposite order, but it makes absolutely no difference as the two rules are mutually exclusive due to the leading space
-			" [P]S=",
-			" [P]N=",
-			" [PROF.]=PROHFEH4SER",
+	return (double)clock() / CLOCKS_PER_SEC;
 #endif
-			"[P]=P",
-		};
+}
 
-		const char* const qrule_eng[] =
+// read all of a stream into memory, for batch mode; returns NULL if memory runs out
+u8* readAllInput(input_file* f, size_t* len, s_cfg c)
+{
+	size_t capacity = RECITER_CHUNK;
+	u8* data = malloc(capacity);
+	*len = 0;
+	while (data)
+	{
+		if (*len == capacity)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[Q]: = KYUW4 ",
-#else
-			" [Q] =KYUW4",
+			u8* const grown = realloc(data, capacity << 1);
+			if (!grown)
+			{
+				free(data);
+				data = NULL;
+				break;
+			}
+			data = grown;
+			capacity <<= 1;
+		}
+		const size_t n = readInput(f, &data[*len], capacity - *len, c);
+		if (!n) break;
+		*len += n;
+	}
+	if (!data) e_printf(V_ERR,"E* Failure to allocate memory for the input, aborting!\n");
+	return data;
+}
+
+void mergeStats(s_stats* into, const s_stats* from)
+{
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		into->lookups[t] += from->lookups[t];
+		into->tried[t] += from->tried[t];
+	}
+	into->dfa_fallbacks += from->dfa_fallbacks;
+	into->mismatches += from->mismatches;
+	into->cache_hits += from->cache_hits;
+	into->cache_misses += from->cache_misses;
+	into->input_bytes += from->input_bytes;
+	into->output_bytes += from->output_bytes;
+	into->output_writes += from->output_writes;
+}
+
+// batch translation: every line of the input is a phrase of its own, so the lines can be translated independently of
+// each other. the input is cut into tasks of whole lines, and each worker translates tasks on a thread of its own,
+// with a translation context of its own, since the automata of a ruleset are built lazily as they are used and
+// can't be shared between threads; the rule library itself is shared by all of them. the output of a task goes on the end of the output buffer of the worker which ran
+// it, and the task notes where, so the output can be written in the order of the input however the tasks were
+// scheduled, without an allocation per task.
+typedef struct batch_task
+{
+	const u8* data; // the lines of this task, up to and including the line break of its last line
+	size_t len;
+	size_t offset; // of data in the whole input
+	u32 worker; // the worker which translated the task, in whose output buffer its translation is
+	u32 output_start; // position of the translation of the task in that buffer
+	u32 done_len; // length of the output of the lines which were translated successfully, each followed by a line break
+	reciter_status status;
+	size_t failed_pos; // position in the whole input of the line which couldn't be translated
+} batch_task;
+
+// nominal number of input bytes in a batch task; a line is never split, so a longer line is a task of its own
+#define BATCH_TASK_BYTES 16384
+
+typedef struct batch_worker batch_worker;
+
+typedef struct batch_pool
+{
+	batch_task* tasks;
+	u32 num_tasks;
+	batch_worker* workers;
+	u32 num_workers;
+} batch_pool;
+
+// work stealing: the tasks start out split evenly between the workers, as a contiguous range of task numbers per
+// worker, which is the worker's deque. a worker takes the next task from the top of its own deque, so it works
+// through its lines in order, and an idle worker steals the bottom half of the deque of the worker with the most
+// tasks left, which becomes its own deque, so long lines bunched up in one part of the input get spread out.
+struct batch_worker
+{
+	reciter_ctx ctx;
+	batch_pool* pool;
+	u32 id;
+	u32 top; // next task to take
+	u32 bottom; // end of the deque
+	vec_u8* output; // the translations of the tasks this worker ran, one after the other
+#ifdef USE_THREADS
+	pthread_mutex_t lock; // of top and bottom
+#endif
+	// timing counters, to see how well the work was balanced
+	u32 tasks; // number of tasks translated
+	u32 steals; // number of times tasks were stolen from another worker
+	u32 stolen; // number of tasks stolen from another worker
+	u64 bytes; // number of input bytes translated
+	double busy; // seconds spent translating
+	double seconds; // seconds from starting until running out of tasks
+};
+
+void lockWorker(batch_worker* w)
+{
+#ifdef USE_THREADS
+	pthread_mutex_lock(&w->lock);
 #endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[QUAR]=KWOH5R ", // extra space
-#else
-			"[QUAR]=KWOH5R",
+}
+
+void unlockWorker(batch_worker* w)
+{
+#ifdef USE_THREADS
+	pthread_mutex_unlock(&w->lock);
 #endif
-			"[QU]=KW",
-			"[Q]=K",
-		};
+}
 
-		const char* const rrule_eng[] =
+// take the next task from the worker's own deque; returns false if it's empty
+bool takeTask(batch_worker* w, u32* task)
+{
+	lockWorker(w);
+	const bool ok = (w->top < w->bottom);
+	if (ok) *task = w->top++;
+	unlockWorker(w);
+	return ok;
+}
+
+// steal the bottom half of the deque of the worker with the most tasks left, rounded up; returns false if every
+// deque is empty, which means there is nothing left to do, since tasks are never added
+bool stealTasks(batch_worker* w)
+{
+	batch_pool* const pool = w->pool;
+	while (true)
+	{
+		// pick a victim; its deque is checked again when stealing from it, since it may have shrunk in the meantime
+		batch_worker* victim = NULL;
+		u32 most = 0;
+		for (u32 i = 1; i < pool->num_workers; i++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[R]: = AA4R ",
-#elif (RULES_VERSION == RULES_APPLE)
-			" [R] =AA4R", // the apple version and onward has a different stress marker for this rule
-#else
-			" [R] =AA5R",
-#endif
-			" [RE]^#=RIY",
-			"[R]R=", // remove double characters (if this is the first one in a chain...)
-			"[R]=R",
-		};
+			batch_worker* const v = &pool->workers[(w->id + i) % pool->num_workers];
+			lockWorker(v);
+			const u32 left = (v->top < v->bottom) ? v->bottom - v->top : 0;
+			unlockWorker(v);
+			if (left > most)
+			{
+				victim = v;
+				most = left;
+			}
+		}
+		if (!victim) return false;
+		lockWorker(victim);
+		const u32 left = (victim->top < victim->bottom) ? victim->bottom - victim->top : 0;
+		u32 mid = 0;
+		u32 end = 0;
+		if (left)
+		{
+			end = victim->bottom;
+			mid = victim->bottom - ((left + 1) >> 1);
+			victim->bottom = mid;
+		}
+		unlockWorker(victim);
+		if (!left) continue; // the victim ran out in the meantime, look for another
+		lockWorker(w);
+		w->top = mid;
+		w->bottom = end;
+		unlockWorker(w);
+		w->steals++;
+		w->stolen += end - mid;
+		return true;
+	}
+}
 
-		const char* const srule_eng[] =
+void runTask(batch_worker* w, batch_task* t)
+{
+	size_t pos = 0;
+	t->status = RECITER_OK;
+	t->worker = w->id;
+	t->output_start = w->output->elements;
+	while (pos < t->len)
+	{
+		const u8* const eol = memchr(&t->data[pos], '\n', t->len - pos);
+		const size_t next = eol ? (size_t)(eol - t->data) + 1 : t->len;
+		size_t end = eol ? next - 1 : t->len;
+		if ((end > pos) && (t->data[end-1] == '\r')) end--;
+		t->status = translateText(&w->ctx, &t->data[pos], end - pos, w->output);
+		if ((t->status == RECITER_OK) && (!vec_u8_append(w->output, w->ctx.c.phoneme_ids ? charPhonemeId('\n') : '\n'))) t->status = RECITER_E_NOMEM;
+		if (t->status != RECITER_OK)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[S]: = EH4S ",
-			" [SO]=SOW",
-#else
-			" [S] =EH4S",
-#endif
-			"[SH]=SH",
-			"#[SION]=ZHUN",
-			"[SOME]=SAHM",
-			"#[SUR]#=ZHER",
-			"[SUR]#=SHER",
-			"#[SU]#=ZHUW",
-			"#[SSU]#=SHUW",
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			// missing a space before =
-			"#[SED]=ZD",
-#else
-			"#[SED] =ZD",
-#endif
-			"#[S]#=Z",
-			"[SAID]=SEHD",
-			"^[SION]=SHUN",
-			"[S]S=", // remove double characters (if this is the first one in a chain...)
-			".[S] =Z",
-			"#:.E[S] =Z",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"#:^##[S] =Z",
-#endif
-			"#:^#[S] =S",
-			"U[S] =S",
-			" :#[S] =Z",
-			"##[S] =Z",
-			" [SCH]=SK",
-			"[S]C+=",
-			"#[SM]=ZUM",
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			"#[SN]'=ZUM", // this is a copy-paste error, and screws up the pronunciation of the words "doesn't", "wasn't", etc.
-#else
-			"#[SN]'=ZUN",
-#endif
-			"[STLE]=SUL",
-			"[S]=S",
-		};
+			t->failed_pos = t->offset + pos;
+			break;
+		}
+		t->done_len = w->output->elements - t->output_start;
+		pos = next;
+	}
+}
+
+void* batchWorker(void* arg)
+{
+	batch_worker* const w = arg;
+	const double start = nowSeconds();
+	u32 task;
+	while (takeTask(w, &task) || (stealTasks(w) && takeTask(w, &task)))
+	{
+		batch_task* const t = &w->pool->tasks[task];
+		const double t0 = nowSeconds();
+		runTask(w, t);
+		w->busy += nowSeconds() - t0;
+		w->tasks++;
+		w->bytes += t->len;
+	}
+	w->seconds = nowSeconds() - start;
+	return NULL;
+}
 
-		const char* const trule_eng[] =
+// timing of a batch translation
+typedef struct batch_timing
+{
+	double seconds; // time it took to translate, not counting setting up the workers
+	double balance; // average time the workers spent translating, relative to the busiest worker; 1 is a perfect balance
+} batch_timing;
+
+// cut len bytes of input into tasks of whole lines, of about BATCH_TASK_BYTES each, but at least a few per worker;
+// returns NULL if memory runs out
+batch_task* splitBatch(const u8* data, const size_t len, const u32 threads, u32* num_tasks)
+{
+	size_t target = len / ((size_t)threads << 3);
+	if (target > BATCH_TASK_BYTES) target = BATCH_TASK_BYTES;
+	if (!target) target = 1;
+	u32 capacity = 64;
+	batch_task* tasks = malloc(capacity * sizeof(batch_task));
+	*num_tasks = 0;
+	size_t start = 0;
+	while (tasks && (start < len))
+	{
+		size_t end = len;
+		if (len - start > target)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[T]: = TIY4 ",
-#else
-			" [T] =TIY4",
-#endif
-			" [THE] #=DHIY",
-			" [THE] =DHAX",
-			"[TO] =TUX",
-			" [THAT]=DHAET",
-			" [THIS] =DHIHS",
-			" [THEY]=DHEY",
-			" [THERE]=DHEHR",
-			"[THER]=DHER",
-			"[THEIR]=DHEHR",
-			" [THAN] =DHAEN",
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			" [THEM] =DHAEN", // this is a copy-paste error, and screws up the pronunciation of the word "them"
-#else
-			" [THEM] =DHEHM",
-#endif
-			"[THESE] =DHIYZ",
-			" [THEN]=DHEHN",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[THROUGH]=THRUW4 ", // extra space
-#else
-			"[THROUGH]=THRUW4",
-#endif
-			"[THOSE]=DHOHZ",
-			"[THOUGH] =DHOW",
-			"[TODAY]=TUXDEY",
-			"[TOMO]RROW=TUMAA5",
-			"[TO]TAL=TOW5",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			" [THUS]=DHAH4S ", // extra space
-#else
-			" [THUS]=DHAH4S",
-#endif
-			"[TH]=TH",
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			"#:[TED]=TIXD", // missing a space before =
-#else
-			"#:[TED] =TIXD",
-#endif
-			"S[TI]#N=CH",
-			"[TI]O=SH",
-			"[TI]A=SH",
-			"[TIEN]=SHUN",
-			"[TUR]#=CHER",
-			"[TU]A=CHUW",
-			" [TWO]=TUW",
-#if (RULES_VERSION >= RULES_APPLE)
-			// the apple version and later of this rule drops the space before the =, and adds another rule below specific to starting with 'F' for the word '[s]often'
-			"&[T]EN=",
-			"F[T]EN=",
-#else
-			"&[T]EN =",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[T]T=", // remove double characters (if this is the first one in a chain...)
-#endif
-			"[T]=T",
-		};
+			const u8* const eol = memchr(&data[start + target - 1], '\n', len - (start + target - 1));
+			if (eol) end = (eol - data) + 1;
+		}
+		if (*num_tasks == capacity)
+		{
+			batch_task* const grown = realloc(tasks, (capacity << 1) * sizeof(batch_task));
+			if (!grown)
+			{
+				free(tasks);
+				return NULL;
+			}
+			tasks = grown;
+			capacity <<= 1;
+		}
+		batch_task* const t = &tasks[(*num_tasks)++];
+		memset(t, 0, sizeof(batch_task));
+		t->data = &data[start];
+		t->len = end - start;
+		t->offset = start;
+		start = end;
+	}
+	return tasks;
+}
 
-		const char* const urule_eng[] =
+// translate len bytes of input a line at a time on up to threads threads, and write the translations to out in the
+// order of the input lines, if out isn't NULL. the statistics of the workers are added to *stats if that isn't NULL.
+bool translateBatch(const u8* data, const size_t len, u32 threads, const rule_handle* handle, const u32 cache_words, FILE* out, batch_timing* timing, s_stats* stats, s_cfg c)
+{
+	if (!threads) threads = 1;
+	batch_pool pool = { NULL, 0, NULL, 0 };
+	pool.tasks = splitBatch(data, len, threads, &pool.num_tasks);
+	pool.workers = calloc(threads, sizeof(batch_worker));
+	bool ok = (pool.tasks && pool.workers);
+	if (!ok) e_printf(V_ERR,"E* Failure to allocate memory for %d workers, aborting!\n", threads);
+	for (u32 i = 0; ok && (i < threads); i++)
+	{
+		batch_worker* const w = &pool.workers[i];
+		w->pool = &pool;
+		w->id = i;
+		w->top = ((u64)pool.num_tasks * i) / threads;
+		w->bottom = ((u64)pool.num_tasks * (i + 1)) / threads;
+#ifdef USE_THREADS
+		pthread_mutex_init(&w->lock, NULL);
+#endif
+		pool.num_workers = i + 1;
+		// room for twice the input of the tasks the worker starts out with; it grows if they are stolen back and forth,
+		// or the translation is longer
+		u64 input = 0;
+		for (u32 k = w->top; k < w->bottom; k++)
+		{
+			input += pool.tasks[k].len;
+		}
+		w->output = vec_u8_alloc(((input << 1) < 0x7fffffff) ? (input << 1) + 16 : 0x7fffffff);
+		if (!w->output->data
+			|| (initContext(&w->ctx, handle, &c, cache_words) != RECITER_OK)
+			|| (c.profile && !(w->ctx.c.profile = allocRuleProfile(w->ctx.ruleset))))
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [U] = YUW4 ",
-#else
-			" [U] =YUW4",
-#endif
-			" [UN]I=YUWN",
-			" [UN]=AHN",
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [UPON]=AXPAA3N",
-#else
-			" [UPON]=AXPAON",
-#endif
-			"@[UR]#=UH4R",
-			"[UR]#=YUH4R",
-			"[UR]=ER",
-			"[U]^ =AH",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[U]^^=AH5 ", // extra space
-			"[UY]=AY5 ", // extra space
-#else
-			"[U]^^=AH5",
-			"[UY]=AY5",
-#endif
-			" G[U]#=",
-			"G[U]%=",
-			"G[U]#=W",
-			"#N[U]=YUW",
-			"@[U]=UW",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"U[U]=", // note that mactalk actually has a broken rule here of "U[U]" with no equals after it. this should remove the second 'U' in a series of multiple 'U's
-			" [USA] =YUW5EHSEY2",
-#endif
-			"[U]=YUW",
-		};
+			e_printf(V_ERR,"E* Failure to set up batch worker %d, aborting!\n", i);
+			ok = false;
+		}
+	}
 
-		const char* const vrule_eng[] =
+	if (ok)
+	{
+		const double t = nowSeconds();
+#ifdef USE_THREADS
+		pthread_t* tid = calloc(threads, sizeof(pthread_t));
+		bool* started = calloc(threads, sizeof(bool));
+		// the first worker runs on this thread; if a thread can't be started, its tasks get stolen by the others
+		for (u32 i = 1; (i < threads) && tid && started; i++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[V]: = VIY4 ",
-#else
-			" [V] =VIY4",
-#endif
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"[VIEW]=VYUW5 ", // extra space
+			started[i] = !pthread_create(&tid[i], NULL, batchWorker, &pool.workers[i]);
+		}
+		batchWorker(&pool.workers[0]);
+		for (u32 i = 1; i < threads; i++)
+		{
+			if (tid && started && started[i]) pthread_join(tid[i], NULL);
+		}
+		free(started);
+		free(tid);
 #else
-			"[VIEW]=VYUW5",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"V[V]=", // note that mactalk actually has a broken rule here of "V[V]" with no equals after it. this should remove the second 'V' in a series of multiple 'V's
+		for (u32 i = 0; i < threads; i++)
+		{
+			batchWorker(&pool.workers[i]);
+		}
 #endif
-			"[V]=V",
-		};
+		double busiest = 0;
+		double total = 0;
+		for (u32 i = 0; i < threads; i++)
+		{
+			const batch_worker* const w = &pool.workers[i];
+			e_printf(V_STATS,"D* Batch worker %d: %d tasks, %d of them stolen in %d steals, %llu bytes, %.4f seconds busy, %.4f seconds idle\n", i, w->tasks, w->stolen, w->steals, (unsigned long long)w->bytes, w->busy, w->seconds - w->busy);
+			if (w->busy > busiest) busiest = w->busy;
+			total += w->busy;
+		}
+		timing->seconds = nowSeconds() - t;
+		timing->balance = busiest ? total / threads / busiest : 1.0;
+	}
 
-		const char* const wrule_eng[] =
+	// write the output in order, up to the first line which couldn't be translated
+	output_writer w = { NULL, NULL, 0, false, NULL };
+	if (out && !outputOpen(&w, out, stats))
+	{
+		e_printf(V_ERR,"E* Failure to allocate memory for the output buffer, aborting!\n");
+		ok = false;
+	}
+	if (stats) stats->input_bytes += len;
+	for (u32 i = 0; ok && (i < pool.num_tasks); i++)
+	{
+		batch_task* const t = &pool.tasks[i];
+		if (out && !outputWrite(&w, &pool.workers[t->worker].output->data[t->output_start], t->done_len))
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[W]: = DAH4BULYUW ",
-#else
-			" [W] =DAH4BULYUW",
-#endif
-			" [WERE]=WER",
-			"[WA]SH=WAA",
-			"[WA]ST=WEY",
-			"[WA]S=WAH",
-			"[WA]T=WAA",
-			"[WHERE]=WHEHR",
-			"[WHAT]=WHAHT",
-			"[WHOL]=/HOWL",
-			"[WHO]=/HUW",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[WH]=W",
-#else
-			"[WH]=WH",
-#endif
-			"[WAR]#=WEHR",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[WAR]=WAO5R",
-#else
-			"[WAR]=WAOR",
-#endif
-			"[WOR]^=WER",
-			"[WR]=R",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[WOM]A=WUH5M",
-			"[WOM]E=WIH5M",
-#else
-			"[WOM]A=WUHM",
-			"[WOM]E=WIHM",
-#endif
-			"[WEA]R=WEH",
-			"[WANT]=WAA5NT",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"ANS[WER]=ER ", // extra space
-#else
-			"ANS[WER]=ER",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			"W[W]=", // remove double characters (if this is the second one in a chain...)
+			e_printf(V_ERR,"E* Error writing the output, aborting!\n");
+			ok = false;
+		}
+		if (t->status != RECITER_OK)
+		{
+			size_t line = 1;
+			for (const u8* p = data; (p = memchr(p, '\n', &data[t->failed_pos] - p)); p++)
+			{
+				line++;
+			}
+			e_printf(V_ERR,"E* Unable to translate line %llu of the input: %s\n", (unsigned long long)line, reciter_strerror(t->status));
+			ok = false;
+		}
+	}
+	if (out && !outputClose(&w) && ok)
+	{
+		e_printf(V_ERR,"E* Error writing the output, aborting!\n");
+		ok = false;
+	}
+	for (u32 i = 0; i < pool.num_workers; i++)
+	{
+		batch_worker* const w = &pool.workers[i];
+		if (stats) mergeStats(stats, &w->ctx.stats);
+		if (stats && c.profile && w->ctx.c.profile) mergeRuleProfile(c.profile, w->ctx.c.profile);
+		freeContext(&w->ctx);
+		vec_u8_free(w->output);
+#ifdef USE_THREADS
+		pthread_mutex_destroy(&w->lock);
 #endif
-			"[W]=W",
-		};
+	}
+	free(pool.workers);
+	free(pool.tasks);
+	return ok;
+}
+
+// write a string as a CSV field, quoted since rules are full of punctuation
+void writeCsvString(FILE* out, const char* str)
+{
+	fputc('"', out);
+	for (; *str; str++)
+	{
+		if (*str == '"') fputc('"', out);
+		fputc(*str, out);
+	}
+	fputc('"', out);
+}
+
+void writeJsonString(FILE* out, const char* str)
+{
+	fputc('"', out);
+	for (; *str; str++)
+	{
+		if ((*str == '"') || (*str == '\\')) fputc('\\', out);
+		fputc(*str, out);
+	}
+	fputc('"', out);
+}
 
-		const char* const xrule_eng[] =
+// write the rule profile to a file, as JSON if its name ends in .json, otherwise as CSV. the CSV has a row for each
+// rule, and a row with rule number "all" for each table.
+bool writeRuleProfile(const char* name, const rule_profile* p, const s_stats* stats, s_cfg c)
+{
+	FILE* out = fopen(name, "w");
+	if (!out)
+	{
+		e_printf(V_ERR,"E* Unable to open rule profile file %s!\n", name);
+		return false;
+	}
+	const size_t name_len = strlen(name);
+	const bool json = (name_len >= 5) && (!strcmp(&name[name_len-5], ".json"));
+	if (json) fprintf(out, "{\n\t\"tick_unit\": \"%s\",\n\t\"tables\": [\n", PROFILE_TICK_UNIT);
+	else fprintf(out, "table,rule,text,lookups,lookup_ticks,tried,exact,prefix,matched,prefix_ticks,suffix_ticks\n");
+	bool first = true;
+	for (u32 t = 0; t < RULES_TOTAL; t++)
+	{
+		const sym_ruleset* const rs = &p->ruleset[t];
+		if (!rs->num_rules) continue;
+		const char table = (t == RULES_PUNCT_DIGIT) ? '?' : 'A'+t;
+		if (json)
 		{
-#if (RULES_VERSION >= RULES_MACINTALK)
-			"?[X]?= BAY ",
-			"? [X] ?=BAY",
-#endif
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[X]: = EH4KS ",
-#elif ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			" [X] =EH4KR", // this is a typo and should be EH4KS to pronounce the letter properly
-#else
-			" [X] =EH4KS",
-#endif
-#if ((RULES_VERSION >= RULES_MACTALK) && (RULES_VERSION <= RULES_MACINTALKDEMO))
-			// Note in mactalk and macintalk 1.0(demo), the two 'by' rules appear here, but cannot EVER work since they get caught by the EH4KS rule above.
-			// This was fixed in macintalk 1.2 and onward by moving the rules above the EH4KS case.
-			"?[X]?= BAY ", // these rules cannot ever be hit due to a bug
-			"? [X] ?=BAY", // these rules cannot ever be hit due to a bug
-#endif
-			" [X]=Z",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"X[X]=", // remove double characters (if this is the second one in a chain...)
-#endif
-			"[X]=KS",
-		};
+			fprintf(out, "%s\t\t{ \"table\": \"%c\", \"lookups\": %llu, \"lookup_ticks\": %llu, \"tried\": %llu, \"rules\": [\n", first ? "" : ",\n", table, (unsigned long long)stats->lookups[t], (unsigned long long)p->lookup_ticks[t], (unsigned long long)stats->tried[t]);
+		}
+		else
+		{
+			fprintf(out, "%c,all,,%llu,%llu,%llu,,,,,\n", table, (unsigned long long)stats->lookups[t], (unsigned long long)p->lookup_ticks[t], (unsigned long long)stats->tried[t]);
+		}
+		first = false;
+		for (u32 i = 0; i < rs->num_rules; i++)
+		{
+			const rule_counters* const r = &p->rules[t][i];
+			if (json)
+			{
+				fprintf(out, "\t\t\t{ \"rule\": %d, \"text\": ", i);
+				writeJsonString(out, rs->crule[i]->text);
+				fprintf(out, ", \"tried\": %llu, \"exact\": %llu, \"prefix\": %llu, \"matched\": %llu, \"prefix_ticks\": %llu, \"suffix_ticks\": %llu }%s\n", (unsigned long long)r->tried, (unsigned long long)r->exact, (unsigned long long)r->prefix, (unsigned long long)r->matched, (unsigned long long)r->prefix_ticks, (unsigned long long)r->suffix_ticks, (i + 1 < rs->num_rules) ? "," : "");
+			}
+			else
+			{
+				fprintf(out, "%c,%d,", table, i);
+				writeCsvString(out, rs->crule[i]->text);
+				fprintf(out, ",,,%llu,%llu,%llu,%llu,%llu,%llu\n", (unsigned long long)r->tried, (unsigned long long)r->exact, (unsigned long long)r->prefix, (unsigned long long)r->matched, (unsigned long long)r->prefix_ticks, (unsigned long long)r->suffix_ticks);
+			}
+		}
+		if (json) fprintf(out, "\t\t] }");
+	}
+	if (json) fprintf(out, "\n\t]\n}\n");
+	const bool ok = !ferror(out);
+	if (fclose(out) || !ok)
+	{
+		e_printf(V_ERR,"E* Error writing rule profile file %s!\n", name);
+		return false;
+	}
+	return true;
+}
+
+// compare the spaces-stripped lines a and b
+bool sameTranslation(const u8* a, const size_t a_len, const u8* b, const size_t b_len)
+{
+	size_t i = 0;
+	size_t j = 0;
+	while (true)
+	{
+		while ((i < a_len) && (a[i] == ' ')) i++;
+		while ((j < b_len) && (b[j] == ' ')) j++;
+		if ((i == a_len) || (j == b_len)) return (i == a_len) && (j == b_len);
+		if (a[i++] != b[j++]) return false;
+	}
+}
 
-		const char* const yrule_eng[] =
+// the end of the line starting at pos, and the start of the next one in *next; a trailing CR isn't part of the line
+size_t lineEnd(const u8* data, const size_t len, const size_t pos, size_t* next)
+{
+	const u8* const eol = memchr(&data[pos], '\n', len - pos);
+	*next = eol ? (size_t)(eol - data) + 1 : len;
+	size_t end = eol ? *next - 1 : len;
+	if ((end > pos) && (data[end-1] == '\r')) end--;
+	return end;
+}
+
+// golden output comparison (-g): every line of the input is translated as a phrase of its own, the way batch mode does,
+// and compared to the same line of a file of expected translations, e.g. the batch mode output of a known good build,
+// ignoring spaces, so translations with the phonemes separated by spaces compare equal as well. the rules used for the
+// lines which don't match are counted, which points at the rules which are likely at fault. returns the number of
+// lines which don't match, or -1 if the comparison couldn't be done.
+s64 compareGolden(const u8* in, const size_t in_len, const u8* golden, const size_t golden_len, const rule_handle* handle, const u32 max_report, s_cfg c)
+{
+	reciter_ctx ctx;
+	rule_log log = { NULL, 0, 0 };
+	vec_u8* output = vec_u8_alloc(256);
+	u32 num_rules = 0;
+	u32 base[RULES_TOTAL];
+	u32* used = NULL; // number of lines each rule was used for
+	u32* failed = NULL; // number of lines which didn't match each rule was used for
+	u32* last = NULL; // last line each rule was counted for
+	bool ok = (initContext(&ctx, handle, &c, 0) == RECITER_OK) && output->data;
+	if (ok)
+	{
+		for (u32 t = 0; t < RULES_TOTAL; t++)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" [Y] = WAY4 ",
-#else
-			" [Y] =WAY4",
-#endif
-			"[YOUNG]=YAHNX",
-			" [YOUR]=YOHR",
-			" [YOU]=YUW",
-			" [YES]=YEHS",
-			" [Y]=Y",
-			"F[Y]=AY",
-#if ((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS))
-			"PS[YCH]=AYK ", // extra space
-#else
-			"PS[YCH]=AYK",
-#endif
-#if ((RULES_VERSION == RULES_C64) && defined(C64_RULES_BUGS))
-			// missing a space before =
-			"#:^[Y]=IY",
-#else
-			"#:^[Y] =IY",
-#endif
-			"#:^[Y]I=IY",
-			" :[Y] =AY",
-			" :[Y]#=AY",
-			" :[Y]^+:#=IH",
-			" :[Y]^#=AY",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"Y[Y]=", // remove double characters (if this is the second one in a chain...)
-#endif
-			"[Y]=IH",
-		};
+			base[t] = num_rules;
+			num_rules += ctx.ruleset[t].num_rules;
+		}
+		used = calloc(num_rules, sizeof(u32));
+		failed = calloc(num_rules, sizeof(u32));
+		last = calloc(num_rules, sizeof(u32));
+		ok = (used && failed && last);
+	}
+	if (!ok) e_printf(V_ERR,"E* Failure to set up the golden output comparison, aborting!\n");
+	ctx.c.used_rules = &log;
 
-		const char* const zrule_eng[] =
+	s64 mismatches = 0;
+	u32 lines = 0;
+	size_t pos = 0;
+	size_t gpos = 0;
+	while (ok && (pos < in_len))
+	{
+		size_t next;
+		size_t gnext;
+		const size_t end = lineEnd(in, in_len, pos, &next);
+		if (gpos == golden_len)
 		{
-#if (RULES_VERSION >= RULES_MACTALK)
-			" :[Z]: = ZIY4 ",
-			"Z[Z]=", // remove double characters (if this is the second one in a chain...)
-#else
-			" [Z] =ZIY4",
-#endif
-			"[Z]=Z",
-		};
+			e_printf(V_ERR,"E* The golden output file ends at line %d of the input!\n", lines + 1);
+			ok = false;
+			break;
+		}
+		const size_t gend = lineEnd(golden, golden_len, gpos, &gnext);
+		lines++;
+		output->elements = 0;
+		log.num = 0;
+		const reciter_status status = translateText(&ctx, &in[pos], end - pos, output);
+		const bool match = (status == RECITER_OK) && sameTranslation(output->data, output->elements, &golden[gpos], gend - gpos);
+		for (u32 k = 0; k < log.num; k++)
+		{
+			const u32 n = base[log.used[k] >> 16] + (log.used[k] & 0xffff);
+			if (last[n] == lines) continue;
+			last[n] = lines;
+			used[n]++;
+			if (!match) failed[n]++;
+		}
+		if (!match)
+		{
+			if (mismatches < max_report)
+			{
+				e_printf(V_ERR,"line %d: '%.*s' translates to '%.*s', expected '%.*s'%s%s\n", lines, (int)(end - pos), &in[pos], (int)output->elements, output->data, (int)(gend - gpos), &golden[gpos], (status == RECITER_OK) ? "" : ": ", (status == RECITER_OK) ? "" : reciter_strerror(status));
+			}
+			mismatches++;
+		}
+		pos = next;
+		gpos = gnext;
+	}
 
-		const char* const punct_num_rule_eng[] =
+	if (ok)
+	{
+		e_printf(V_ERR,"golden output comparison: %d lines, %lld mismatches\n", lines, (long long)mismatches);
+		// the rules most likely at fault: those used by the most lines which don't match, weighted by the share of all the
+		// lines using them which don't match, so the rules which almost every word uses don't crowd out the others
+		for (u32 k = 0; mismatches && (k < max_report); k++)
 		{
-#if (RULES_VERSION < RULES_MACTALK)
-			"[A]=", // this is a broken rule and can never be hit, may have been left from debugging, and only exists in the 6502 versions
-#endif
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[ ]= ",
-			"[...]= THRUW ",
-			"[.]?= POY5NT ",
-			"[.] =.",
-			"[.]= ",
-#endif
-			"[!]=.",
-#if (((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS)) || (RULES_VERIONS >= RULES_MACTALK))
-			"[\"] =-AH5NKWOWT- ", // extra space... which became a feature later
-#else
-			"[\"] =-AH5NKWOWT-",
-#endif
-			"[\"]=KWOW4T-",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[#]= NAH4MBER ",
-			"C['S]=S",
-			"G['S]=Z",
-			"&['S]=IHZ",
-			".['S]=Z",
-			"#:&E['S]=IHZ",
-			"#:.E['S]=Z",
-			"#:^E['S]=S",
-			"#['S]=Z",
-			"['S]=S",
-			"['T]=T",
-			"['LL]=L",
-			"['D]=D",
-			"['M]=M",
-			"[$]= DAA4LER ",
-			"[%]= PERSEH4NT ",
-			"[&]= AEND ",
-#else
-			"[#]= NAH4MBER",
-			"[$]= DAA4LER",
-			"[%]= PERSEH4NT",
-			"[&]= AEND",
-#endif
-			"[']=",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[*]= AE4STERIHSK ",
-			"[+]= PLAH4S ",
-#else
-			"[*]= AE4STERIHSK",
-			"[+]= PLAH4S",
-#endif
-			"[,]=,",
-			" [-] =-",
-			"[-]=",
-#if (RULES_VERSION >= RULES_MACTALK)
-			"[/]= SLAE4SH ",
-#else
-			"[.]= POYNT",
-			"[/]= SLAE4SH",
-#endif
+			u32 worst = 0;
+			for (u32 n = 1; n < num_rules; n++)
+			{
+				if (failed[n] && ((!failed[worst]) || ((u64)failed[n] * failed[n] * used[worst] > (u64)failed[worst] * failed[worst] * used[n]))) worst = n;
+			}
+			if (!failed[worst]) break;
+			u32 t = RULES_TOTAL - 1;
+			while (base[t] > worst) t--;
+			e_printf(V_ERR,"  %c rule %d %s: used by %d mismatching lines, %.1f%% of the %d lines using it\n", (t == RULES_PUNCT_DIGIT) ? '?' : 'A'+t, worst - base[t], ctx.ruleset[t].crule[worst - base[t]]->text, failed[worst], 100.0 * failed[worst] / used[worst], used[worst]);
+			failed[worst] = 0;
+		}
+	}
+	free(used);
+	free(failed);
+	free(last);
+	free(log.used);
+	vec_u8_free(output);
+	freeContext(&ctx);
+	return ok ? mismatches : -1;
+}
 
-			// *** begin digit rules; these are in their own table in mactalk and later
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[0]= ZIY4ROW ",
-#else
-			"[0]= ZIY4ROW",
-#endif
-			" [1ST]=FER4ST",
-			" [10TH]=TEH4NTH",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			" [10] = TEH4N ",
-			"[1]= WAH4N ",
-#else
-			"[1]= WAH4N",
-#endif
-			" [2ND]=SEH4KUND",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[2]= TUW4 ",
-#else
-			"[2]= TUW4",
-#endif
-			" [3RD]=THER4D",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[3]= THRIY4 ",
-			"[4]= FOH4R ",
-#else
-			"[3]= THRIY4",
-			"[4]= FOH4R",
-#endif
-			" [5TH]=FIH4FTH",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[5]= FAY4V ",
-#else
-			"[5]= FAY4V",
-#endif
-#if ((RULES_VERSION == RULES_C64) || defined(C64_ADDED_RULES))
-			" [64] =SIH4KSTIY FOHR",
-#endif
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[6]= SIH4KS ",
-			"[7]= SEH4VUN ",
-#else
-			"[6]= SIH4KS",
-			"[7]= SEH4VUN",
-#endif
-			" [8TH]=EY4TH",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[8]= EY4T ",
-			"[9]= NAY4N ",
-#else
-			"[8]= EY4T",
-			"[9]= NAY4N",
-#endif
-			// *** end digit rules
+// number of mismatching lines and rules reported by the golden output comparison
+#define GOLDEN_REPORT_LINES 20
 
-#if (((RULES_VERSION == RULES_APPLE) && defined(APPLE_RULES_BUGS)) || (RULES_VERIONS >= RULES_MACTALK))
-			"[:]=. ", // extra space... which became a feature later
-#else
-			"[:]=.",
-#endif
-			"[;]=.",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[<]= LEH4S DHAEN ",
-			"[=]= IY4KWULZ ",
-			"[>]= GREY4TER DHAEN ",
-#else
-			"[<]= LEH4S DHAEN",
-			"[=]= IY4KWULZ",
-			"[>]= GREY4TER DHAEN",
-#endif
-			"[?]=.",
-#if (RULES_VERIONS >= RULES_MACTALK)
-			"[@]= AE6T ",
-			"[(]=,",
-			"[)]=,",
-			"[^]= KAE4RIHT ",
-			"[~]=NAA4T ",
-			"[\]= ",
-			"[[]= ",
-			"[{]= ",
-			"[}]= ",
-			"[|]=OH4R ",
-			"[_]= ",
-			"[`]= ",
-			"[]= ",
-#else
-			"[@]= AE6T",
-			"[^]= KAE4RIXT",
+// number of threads to use by default, one per online processor
+u32 defaultThreads()
+{
+#ifdef USE_THREADS
+	const long n = sysconf(_SC_NPROCESSORS_ONLN);
+	if (n > 0) return (n < 256) ? n : 256;
 #endif
-		};
-		sym_ruleset ruleset[RULES_TOTAL] =
-		{
-			{ sizeof(arule_eng)/sizeof(*arule_eng), arule_eng },
-			{ sizeof(brule_eng)/sizeof(*brule_eng), brule_eng },
-			{ sizeof(crule_eng)/sizeof(*crule_eng), crule_eng },
-			{ sizeof(drule_eng)/sizeof(*drule_eng), drule_eng },
-			{ sizeof(erule_eng)/sizeof(*erule_eng), erule_eng },
-			{ sizeof(frule_eng)/sizeof(*frule_eng), frule_eng },
-			{ sizeof(grule_eng)/sizeof(*grule_eng), grule_eng },
-			{ sizeof(hrule_eng)/sizeof(*hrule_eng), hrule_eng },
-			{ sizeof(irule_eng)/sizeof(*irule_eng), irule_eng },
-			{ sizeof(jrule_eng)/sizeof(*jrule_eng), jrule_eng },
-			{ sizeof(krule_eng)/sizeof(*krule_eng), krule_eng },
-			{ sizeof(lrule_eng)/sizeof(*lrule_eng), lrule_eng },
-			{ sizeof(mrule_eng)/sizeof(*mrule_eng), mrule_eng },
-			{ sizeof(nrule_eng)/sizeof(*nrule_eng), nrule_eng },
-			{ sizeof(orule_eng)/sizeof(*orule_eng), orule_eng },
-			{ sizeof(prule_eng)/sizeof(*prule_eng), prule_eng },
-			{ sizeof(qrule_eng)/sizeof(*qrule_eng), qrule_eng },
-			{ sizeof(rrule_eng)/sizeof(*rrule_eng), rrule_eng },
-			{ sizeof(srule_eng)/sizeof(*srule_eng), srule_eng },
-			{ sizeof(trule_eng)/sizeof(*trule_eng), trule_eng },
-			{ sizeof(urule_eng)/sizeof(*urule_eng), urule_eng },
-			{ sizeof(vrule_eng)/sizeof(*vrule_eng), vrule_eng },
-			{ sizeof(wrule_eng)/sizeof(*wrule_eng), wrule_eng },
-			{ sizeof(xrule_eng)/sizeof(*xrule_eng), xrule_eng },
-			{ sizeof(yrule_eng)/sizeof(*yrule_eng), yrule_eng },
-			{ sizeof(zrule_eng)/sizeof(*zrule_eng), zrule_eng },
-			{ sizeof(punct_num_rule_eng)/sizeof(*punct_num_rule_eng), punct_num_rule_eng },
-		};
-	//}
+	return 1;
+}
+
+void usage()
+{
+	printf("Usage: executablename parameters\n");
+	printf("Brief explanation of function of executablename\n");
+	printf("\n");
+	printf("The translation of the input file is written to stdout. The input file can be - for stdin, or a pipe; such\n");
+	printf("input is translated as it arrives, and its translation is written as soon as enough of the input after each\n");
+	printf("word has been read.\n");
+	printf("\n");
+	printf("Options:\n");
+	printf("  -v <n>      verbosity bitmask; 256 echoes the input file and its translation to stderr as well\n");
+	printf("  -n          don't use the rule dispatch index, try every rule of a table in turn\n");
+	printf("  -c <n>      cache the translations of up to n recently seen words (default 0, no cache)\n");
+	printf("  -b          batch mode: translate each line of the input as a phrase of its own, on several threads,\n");
+	printf("              and write the translation of each line on a line of its own to stdout\n");
+	printf("  -j <n>      number of threads for batch mode (default 0, one per processor)\n");
+	printf("  -i          write phoneme IDs, a byte per phoneme, stress digit or other character, rather than text;\n");
+	printf("              to stdout for a file as for a stream; the echo of -v 256 still shows them as text\n");
+	printf("  -s          batch mode scaling benchmark: time translating the input on 1, 2, 4... up to -j threads\n");
+	printf("  -g <file>   compare the translation of each line of the input to the same line of file, e.g. the -b output\n");
+	printf("              of a known good build, ignoring spaces, and report the lines and rules which don't match\n");
+	printf("  -p <file>   count how often each rule is tried and used, and time its prefix and suffix matching, and\n");
+	printf("              write these to file at exit, as JSON if its name ends in .json, otherwise as CSV\n");
+	printf("  -m <name>   rule matcher: interp (try the rules in turn), dfa (rule list automaton) or\n");
+	printf("              check (run both on every lookup and report any disagreement)\n");
+	printf("  -r <spec>   ruleset version and rule switches, as name[,+switch][,-switch]...\n");
+	printf("              versions:");
+	for (u32 i = 0; i < NUM_RULE_VARIANTS; i++)
+	{
+		printf(" %s", rule_variants[i].name);
+	}
+	printf("\n");
+	printf("              switches:");
+	for (u32 i = 0; i < NUM_RULE_FLAGS; i++)
+	{
+		printf(" %s", rule_flag_names[i]);
+	}
+	printf("\n");
+}
+
+#define NUM_PARAMETERS 1
+
+int main(int argc, char **argv)
+{
+	s_cfg c = default_cfg;
+	s_stats stats = {0};
+	c.stats = &stats;
+	atexit(traceFlush);
+	u32 rules_version = RULES_DEFAULT;
+	u32 rules_flags = RULES_FLAGS_DEFAULT;
+	u32 cache_words = 0;
+	bool batch = false;
+	bool scaling = false;
+	u32 threads = 0;
+	const char* profile_name = NULL;
+	const char* golden_name = NULL;
 
 	// handle optional parameters
 	u32 paramidx = 2;
@@ -2608,6 +4687,59 @@ int main(int argc, char **argv)
 				if (!sscanf(argv[paramidx], "%d", &c.verbose)) { e_printf(V_ERR,"E* Unable to parse argument for -v parameter!\n"); usage(); exit(1); }
 				paramidx++;
 				break;
+			case 'n':
+				c.use_index = false;
+				break;
+			case 'c':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -c parameter!\n"); usage(); exit(1); }
+				if ((!sscanf(argv[paramidx], "%u", &cache_words)) || (cache_words > 0x7fffffff)) { e_printf(V_ERR,"E* Unable to parse argument for -c parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 'b':
+				batch = true;
+				break;
+			case 'i':
+				c.phoneme_ids = true;
+				break;
+			case 'j':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -j parameter!\n"); usage(); exit(1); }
+				if ((!sscanf(argv[paramidx], "%u", &threads)) || (threads > 256)) { e_printf(V_ERR,"E* Unable to parse argument for -j parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 's':
+				batch = true;
+				scaling = true;
+				break;
+			case 'g':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -g parameter!\n"); usage(); exit(1); }
+				golden_name = argv[paramidx];
+				paramidx++;
+				break;
+			case 'p':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -p parameter!\n"); usage(); exit(1); }
+				profile_name = argv[paramidx];
+				paramidx++;
+				break;
+			case 'm':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -m parameter!\n"); usage(); exit(1); }
+				for (c.matcher = 0; c.matcher < NUM_MATCHERS; c.matcher++)
+				{
+					if (!strcmp(matcher_names[c.matcher], argv[paramidx])) break;
+				}
+				if (c.matcher == NUM_MATCHERS) { e_printf(V_ERR,"E* Unknown matcher %s for -m parameter!\n", argv[paramidx]); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 'r':
+				paramidx++;
+				if (paramidx == (argc-0)) { e_printf(V_ERR,"E* Too few arguments for -r parameter!\n"); usage(); exit(1); }
+				if (!parseRuleSpec(argv[paramidx], &rules_version, &rules_flags)) { e_printf(V_ERR,"E* Unable to parse ruleset %s for -r parameter!\n", argv[paramidx]); usage(); exit(1); }
+				paramidx++;
+				break;
 			case '\0':
 				// end of string for parameter, go to next param
 				paramidx++;
@@ -2617,7 +4749,54 @@ int main(int argc, char **argv)
 				break;
 		}
 	}
-	e_printf(V_PARAM,"D* Parameters: verbose: %d\n", c.verbose);
+	if (golden_name && c.phoneme_ids) { e_printf(V_ERR,"E* The -g and -i parameters can't be used together!\n"); usage(); exit(1); }
+
+	// compile the rule strings of every ruleset variant into their pre-split form, once, before any matching happens
+	rule_library lib;
+	const char* malformed;
+	if (!initRuleLibrary(&lib, &malformed))
+	{
+		if (malformed) e_printf(V_ERR,"E* Malformed rule %s, aborting!\n", malformed);
+		else e_printf(V_ERR,"E* Unable to compile rulesets, aborting!\n");
+		freeRuleLibrary(&lib);
+		return 1;
+	}
+	e_printf(V_PARAM,"D* Rule library: %d variants, %d rule references, %d distinct rules, %d distinct rule lists holding %d rules\n", (u32)NUM_RULE_HANDLES, lib.num_refs, lib.pool_size, lib.num_lists, lib.lists_size);
+	const rule_handle* handle = findRuleHandle(&lib, rules_version, rules_flags);
+	rule_tables tables;
+	initRuleTables(&tables, handle);
+	const sym_ruleset* const ruleset = tables.ruleset;
+	c.rules_version = handle->variant->version;
+	e_printf(V_PARAM,"D* Parameters: verbose: %d, ruleset: %s, rule switches: %d\n", c.verbose, handle->variant->name, handle->flags);
+	if (!threads) threads = defaultThreads();
+	if (batch) e_printf(V_PARAM,"D* Batch mode: %d threads\n", threads);
+	// the trace buffer can only be used by one thread, and traces of several at once would be unreadable anyway
+	if (batch && (threads > 1)) c.verbose &= ~V_TRACE_BITS;
+	// in batch mode, each worker has a word cache of its own
+	if (cache_words && !batch)
+	{
+		c.cache = allocWordCache(ruleset, cache_words, c);
+		if (!c.cache)
+		{
+			e_printf(V_ERR,"E* Failure to allocate a word cache of %d words, aborting!\n", cache_words);
+			freeRuleTables(&tables);
+			freeRuleLibrary(&lib);
+			return 1;
+		}
+		e_printf(V_PARAM,"D* Word cache: %d words, keyed with %d break characters of context before and %d after most words, %d rules see further\n", cache_words, c.cache->reach_left, c.cache->reach_right, c.cache->num_far);
+	}
+	if (profile_name)
+	{
+		c.profile = allocRuleProfile(ruleset);
+		if (!c.profile)
+		{
+			e_printf(V_ERR,"E* Failure to allocate the rule profile, aborting!\n");
+			freeWordCache(c.cache);
+			freeRuleTables(&tables);
+			freeRuleLibrary(&lib);
+			return 1;
+		}
+	}
 
 
 	if (argc < 2)
@@ -2628,76 +4807,181 @@ int main(int argc, char **argv)
 	}
 
 // input file
-	FILE *in = fopen(argv[1], "rb");
-	if (!in)
+	input_file f;
+	if (!openInputFile(argv[1], &f, c))
 	{
-		e_printf(V_ERR,"E* Unable to open input file %s!\n", argv[1]);
+		freeWordCache(c.cache);
+		freeRuleProfile(c.profile);
+		freeRuleTables(&tables);
+		freeRuleLibrary(&lib);
 		return 1;
 	}
 
-	fseek(in, 0, SEEK_END);
-	uint32_t len = ftell(in);
-	rewind(in); //fseek(in, 0, SEEK_SET);
-
-	uint8_t *dataArray = (uint8_t *) malloc((len) * sizeof(uint8_t));
-	if (dataArray == NULL)
+	vec_u8* d_out = vec_u8_alloc(4);
+	bool ok;
+	bool golden_ok = true;
+	if (golden_name)
 	{
-		e_printf(V_ERR,"E* Failure to allocate memory for array of size %d, aborting!\n", len);
-		fclose(in);
-		return 1;
+		input_file g;
+		ok = openInputFile(golden_name, &g, c);
+		size_t len = f.len;
+		size_t golden_len = g.len;
+		u8* const data = (ok && f.stream) ? readAllInput(&f, &len, c) : NULL;
+		u8* const golden = (ok && g.stream) ? readAllInput(&g, &golden_len, c) : NULL;
+		const u8* const in = f.stream ? data : f.data;
+		const u8* const expected = g.stream ? golden : g.data;
+		ok = ok && ((in != NULL) || (len == 0)) && ((expected != NULL) || (golden_len == 0));
+		// the mismatches are reported, but they aren't an error of the program, so they only show up in the exit code
+		const s64 mismatches = ok ? compareGolden(in, len, expected, golden_len, handle, GOLDEN_REPORT_LINES, c) : -1;
+		ok = (mismatches >= 0);
+		golden_ok = (mismatches == 0);
+		free(data);
+		free(golden);
+		closeInputFile(&g);
+		closeInputFile(&f);
 	}
-
-	{ // scope limiter for temp
-		uint32_t temp = fread(dataArray, sizeof(uint8_t), len, in);
-		fclose(in);
-		if (temp != len)
+	else if (batch)
+	{
+		// the lines are split between the workers up front, so all of the input has to be in memory
+		size_t len = f.len;
+		u8* const data = f.stream ? readAllInput(&f, &len, c) : NULL;
+		const u8* const in = f.stream ? data : f.data;
+		ok = (in != NULL) || (len == 0);
+		if (ok && scaling)
 		{
-			e_printf(V_ERR,"E* Error reading in %d elements, only read in %d, aborting!\n", len, temp);
-			free(dataArray);
-			dataArray = NULL;
-			return 1;
+			double base = 0;
+			printf("threads   seconds      MB/s   speedup   balance\n");
+			for (u32 n = 1; ok; n = ((n << 1) < threads) ? (n << 1) : threads)
+			{
+				batch_timing timing = { 0, 0 };
+				ok = translateBatch(in, len, n, handle, cache_words, NULL, &timing, NULL, c);
+				if (!ok) break;
+				const double seconds = timing.seconds;
+				if (n == 1) base = seconds;
+				printf("%7d %9.4f %9.2f %8.2fx %9.2f\n", n, seconds, seconds ? len / seconds / 1e6 : 0.0, seconds ? base / seconds : 0.0, timing.balance);
+				fflush(stdout);
+				if (n == threads) break;
+			}
 		}
-		e_printf(V_PARSE,"D* Successfully read in %d bytes\n", temp);
+		else if (ok)
+		{
+			batch_timing timing = { 0, 0 };
+			ok = translateBatch(in, len, threads, handle, cache_words, stdout, &timing, &stats, c);
+			e_printf(V_STATS,"D* Batch mode: %llu bytes translated on %d threads in %.4f seconds, %.2f load balance\n", (unsigned long long)len, threads, timing.seconds, timing.balance);
+		}
+		free(data);
+		closeInputFile(&f);
 	}
-
-	// actual program goes here
-
-	// allocate a vector
-	vec_char32* d_raw = vec_char32_alloc(4);
-
-	// read contents of dataArray into vec_char32
-	for (u32 i = 0; i < len; i++)
+	else
+	{
+		// the translation goes to stdout, and for a stream as soon as each piece of it is translated. as a debugging aid,
+		// a file and its translation can be echoed to stderr as well; a stream can't be echoed before it has all been
+		// read, so it never is, and the translation is only collected for the echo
+		const bool echo = V_ECHO && !f.stream;
+		if (echo)
+		{
+			// echo the preprocessed input
+			e_printf(V_ECHO,"vec_u8 contents: '");
+			for (size_t pos = 0; pos < f.len + 2; pos++)
+			{
+				fputc(inputChar(&f, pos), stderr);
+			}
+			e_printf(V_ECHO,"'\n");
+		}
+		output_writer w;
+		ok = outputOpen(&w, stdout, &stats);
+		if (!ok) e_printf(V_ERR,"E* Failure to allocate memory for the output buffer, aborting!\n");
+		ok = ok && translateInput(ruleset, &f, d_out, echo ? NULL : &w, c);
+		closeInputFile(&f);
+		if (ok && echo)
+		{
+			ok = outputWrite(&w, d_out->data, d_out->elements);
+			if (c.phoneme_ids)
+			{
+				// show the phoneme IDs as text
+				vec_u8* text = vec_u8_alloc(d_out->elements * 2 + 1);
+				if (text->data)
+				{
+					text->elements = formatPhonemeIds(d_out->data, d_out->elements, (char*)text->data);
+					vec_u8_dbg_print(text);
+				}
+				vec_u8_free(text);
+			}
+			else vec_u8_dbg_print(d_out);
+		}
+		const u8 eol = c.phoneme_ids ? charPhonemeId('\n') : '\n';
+		outputWrite(&w, &eol, 1);
+		if (!outputClose(&w) && ok)
+		{
+			e_printf(V_ERR,"E* Error writing the output, aborting!\n");
+			ok = false;
+		}
+	}
+	if (!ok)
 	{
-		vec_char32_append(d_raw,dataArray[i]);
+		vec_u8_free(d_out);
+		freeWordCache(c.cache);
+		freeRuleProfile(c.profile);
+		freeRuleTables(&tables);
+		freeRuleLibrary(&lib);
+		return 1;
 	}
-	//e_printf(V_DEBUG,"Input phrase stats are:\n");
-	//vec_char32_dbg_stats(d_raw);
-	//vec_char32_dbg_print(d_raw);
-
-	// free the input array
-	free(dataArray);
-	dataArray = NULL;
 
-	// allocate another vector for preprocessing
-	vec_char32* d_in = vec_char32_alloc(4);
-	// preprocess d_raw into d_in
-	preProcess(d_raw, d_in, c);
-	vec_char32_free(d_raw);
+	vec_u8_free(d_out);
 
-	//e_printf(V_DEBUG,"Preprocessing done, stats are now:\n");
-	//vec_char32_dbg_stats(d_in);
-	vec_char32_dbg_print(d_in);
 
-	// do stuff with preprocessed phrase here, i.e. the rest of the owl
-	// allocate another vector for output
-	vec_char32* d_out = vec_char32_alloc(4);
-	processPhrase(ruleset, d_in, d_out, c);
-	vec_char32_free(d_in);
-	//e_printf(V_DEBUG,"Processing done, stats are now:\n");
-	//vec_char32_dbg_stats(d_out);
-	vec_char32_dbg_print(d_out);
+	if (V_STATS)
+	{
+		u64 total_lookups = 0;
+		u64 total_tried = 0;
+		e_printf(V_STATS, "D* Rules tried per table lookup (%s):\n", c.use_index ? "dispatch index" : "linear search");
+		for (u32 t = 0; t < RULES_TOTAL; t++)
+		{
+			if (!stats.lookups[t]) continue;
+			e_printf(V_STATS, "D*   %c: %llu lookups, %llu rules tried, %.2f rules/lookup\n", (t == RULES_PUNCT_DIGIT) ? '?' : 'A'+t, (unsigned long long)stats.lookups[t], (unsigned long long)stats.tried[t], (double)stats.tried[t]/stats.lookups[t]);
+			total_lookups += stats.lookups[t];
+			total_tried += stats.tried[t];
+		}
+		if (total_lookups) e_printf(V_STATS, "D*   all: %llu lookups, %llu rules tried, %.2f rules/lookup\n", (unsigned long long)total_lookups, (unsigned long long)total_tried, (double)total_tried/total_lookups);
+		if ((c.matcher != MATCHER_INTERP) && !batch)
+		{
+			u32 lists = 0;
+			u32 states = 0;
+			for (u32 t = 0; t < RULES_TOTAL; t++)
+			{
+				if (!tables.automata[t].ok) continue;
+				lists++;
+				states += tables.automata[t].side[0].num_states + tables.automata[t].side[1].num_states;
+			}
+			e_printf(V_STATS, "D* Automata: %d rule lists built, %d states, %llu lookups fell back to the interpreter\n", lists, states, (unsigned long long)stats.dfa_fallbacks);
+		}
+		if (stats.output_writes)
+		{
+			e_printf(V_STATS, "D* Output: %llu bytes of input, %llu bytes of output in %llu writes, %.2f writes per MB of input\n", (unsigned long long)stats.input_bytes, (unsigned long long)stats.output_bytes, (unsigned long long)stats.output_writes, stats.input_bytes ? stats.output_writes * 1e6 / stats.input_bytes : 0.0);
+		}
+		if (cache_words)
+		{
+			const u64 words = stats.cache_hits + stats.cache_misses;
+			e_printf(V_STATS, "D* Word cache: %llu hits, %llu misses, %.2f%% hit rate", (unsigned long long)stats.cache_hits, (unsigned long long)stats.cache_misses, words ? 100.0*stats.cache_hits/words : 0.0);
+			if (c.cache) e_printf(V_STATS, ", %d of %d words in use", c.cache->used, c.cache->capacity);
+			e_printf(V_STATS, "\n");
+		}
+	}
+	if (c.matcher == MATCHER_CHECK)
+	{
+		e_printf(V_ERR, "matcher check: %llu mismatches\n", (unsigned long long)stats.mismatches);
+	}
 
-	vec_char32_free(d_out);
+	bool profile_ok = true;
+	if (c.profile)
+	{
+		profile_ok = writeRuleProfile(profile_name, c.profile, &stats, c);
+		freeRuleProfile(c.profile);
+	}
+	freeWordCache(c.cache);
+	freeRuleTables(&tables);
+	freeRuleLibrary(&lib);
 
-	return 0;
+	return (stats.mismatches != 0) || !profile_ok || !golden_ok;
 }
+#endif
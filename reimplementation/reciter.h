@@ -0,0 +1,60 @@
+// license:All rights Reserved (for now, contact about licensing if you need it)
+// copyright-holders:Jonathan Gevaryahu
+// Library interface of the reimplementation of the Don't Ask Computer Software/Softvoice 'reciter'/'translator' engine
+// Copyright (C)2021-2024 Jonathan Gevaryahu
+//
+// Build reciter.c with RECITER_NO_MAIN defined to link it into another program, e.g.
+//   cc -c -DRECITER_NO_MAIN reciter.c
+// only the reciter_* functions below are visible outside of it then. they never print anything; the outcome of every
+// call is its reciter_status.
+#ifndef RECITER_H
+#define RECITER_H
+#include <stddef.h>
+
+// result of a library call
+typedef enum reciter_status
+{
+	RECITER_OK = 0,
+	RECITER_E_ARG, // invalid argument, or a ruleset specification which couldn't be parsed
+	RECITER_E_NOMEM, // out of memory
+	RECITER_E_TOO_LONG, // the input is too long to translate in one call
+	RECITER_E_OUTPUT_FULL, // the output buffer is full; as much of the output as fit was written to it
+	RECITER_E_NO_RULE, // no rule matched the input at some position
+	RECITER_E_BAD_RULE, // a rule has an invalid character in it
+	RECITER_E_BAD_INPUT, // a character in the input which is neither punctuation, a digit, a letter, nor ignored
+} reciter_status;
+
+// the compiled rules of every ruleset version with every combination of rule switches. a library is built once, and is
+// never modified after that, so any number of contexts on any number of threads can share it; it has to outlive them.
+typedef struct reciter_library reciter_library;
+// one ruleset version with one combination of rule switches, in a library
+typedef struct reciter_rules reciter_rules;
+
+reciter_status reciter_library_create(reciter_library** lib);
+void reciter_library_destroy(reciter_library* lib);
+
+// find the rules of a library for a ruleset version and rule switches, given as for the -r option of the command line
+// program (e.g. "macintalk,-uic"), or the default ruleset if spec is NULL
+reciter_status reciter_find_rules(const reciter_library* lib, const char* spec, const reciter_rules** rules);
+
+// a translation context: the rules it translates with, and its own rule automata, character feature table and buffer
+// for the preprocessed input. a context can be used for any number of translations, but only by one thread at a time.
+typedef struct reciter_ctx reciter_ctx;
+
+// create a context which translates with rules; nothing is compiled, so this is cheap
+reciter_status reciter_create(const reciter_rules* rules, reciter_ctx** ctx);
+void reciter_destroy(reciter_ctx* ctx);
+
+// cache the translations of up to words recently seen words in the context, or stop caching them if words is 0; the
+// output is the same either way
+reciter_status reciter_set_cache(reciter_ctx* ctx, size_t words);
+
+// translate len bytes of English text at in into phonemes, written to the caller's buffer out of size cap; the number
+// of bytes written is stored in *out_len, and the output is not NUL terminated. a terminating character (0x1b, ESC) in
+// the input ends the translation there. no memory is allocated, unless the input is longer than any before it.
+reciter_status reciter_translate(reciter_ctx* ctx, const char* in, size_t len, char* out, size_t cap, size_t* out_len);
+
+// a short description of a status code
+const char* reciter_strerror(reciter_status status);
+
+#endif
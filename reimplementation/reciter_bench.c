@@ -0,0 +1,494 @@
+// license:All rights Reserved (for now, contact about licensing if you need it)
+// copyright-holders:Jonathan Gevaryahu
+// Benchmarks of the reimplementation of the Don't Ask Computer Software/Softvoice 'reciter'/'translator' engine
+// Copyright (C)2021-2024 Jonathan Gevaryahu
+//
+// This includes reciter.c itself, so it can time the internal stages of the translation:
+//   cc -O2 -o reciter_bench reciter_bench.c
+//
+// Each benchmark is run over each corpus: a few built in, generated ones (a dictionary word list, prose, digit heavy
+// text and punctuation heavy text, always the same for a given size), plus any files given with -i.
+//   preprocess  preProcess() and classifyInput() of the whole corpus
+//   rule        processRule() for each letter table (and the punctuation/digit table, '?'), at every position
+//               processPhrase() would look a rule up in that table
+//   phrase      processPhrase() of the whole corpus, i.e. the whole translation
+//   output      translateInput() of the whole corpus as the command line program does it, a block at a time, with the
+//               output written to the null device through an output_writer; writes is the number of write system
+//               calls that took, which is also given per megabyte of input
+// Each is run a few times to warm up, then timed for a number of repetitions; the minimum, percentiles and maximum of the
+// time per repetition, and the throughput at the median, are printed as CSV or JSON, so runs of different commits can be
+// compared.
+// the POSIX declarations of the system headers, for clock_gettime() among others; see reciter.c
+#define _POSIX_C_SOURCE 200809L
+#define RECITER_NO_MAIN 1
+#include "reciter.c"
+
+#ifdef _WIN32
+#define BENCH_NULL_DEVICE "NUL"
+#else
+#define BENCH_NULL_DEVICE "/dev/null"
+#endif
+
+// monotonic wall clock time in seconds
+double benchSeconds()
+{
+#ifdef USE_MONOTONIC_CLOCK
+	struct timespec t;
+	clock_gettime(CLOCK_MONOTONIC, &t);
+	return t.tv_sec + t.tv_nsec * 1e-9;
+#else
+	return (double)clock() / CLOCKS_PER_SEC;
+#endif
+}
+
+// the generated corpora are made of these words; a mix of common and less common words, so most letter tables and a
+// good share of their rules get used
+static const char* const bench_words[] =
+{
+	"the", "of", "and", "to", "in", "is", "you", "that", "it", "he", "was", "for", "on", "are", "as", "with", "his",
+	"they", "at", "be", "this", "have", "from", "or", "one", "had", "by", "word", "but", "not", "what", "all", "were",
+	"we", "when", "your", "can", "said", "there", "use", "an", "each", "which", "she", "do", "how", "their", "if",
+	"will", "up", "other", "about", "out", "many", "then", "them", "these", "so", "some", "her", "would", "make",
+	"like", "him", "into", "time", "has", "look", "two", "more", "write", "go", "see", "number", "no", "way", "could",
+	"people", "my", "than", "first", "water", "been", "call", "who", "oil", "its", "now", "find", "long", "down",
+	"day", "did", "get", "come", "made", "may", "part", "through", "thought", "enough", "laugh", "knight", "psychology",
+	"rhythm", "queue", "juice", "sluice", "bureau", "colonel", "yacht", "choir", "island", "xylophone", "quiz",
+	"jazz", "zephyr", "vague", "unique", "whose", "wrought", "answer", "debt", "honest", "tongue", "cough", "bough",
+	"though", "through", "tough", "gnome", "mnemonic", "pneumonia", "receipt", "science", "sword", "walk", "would",
+	"average", "beautiful", "computer", "dictionary", "electric", "frequency", "generation", "harmonious",
+	"imagination", "jeopardy", "kaleidoscope", "leisure", "mischievous", "necessary", "opportunity", "phenomenon",
+	"questionnaire", "rhinoceros", "separate", "thoroughly", "umbrella", "vacuum", "Wednesday", "exaggerate",
+	"yesterday", "zoology", "synthesizer", "phoneme", "pronunciation", "translation", "reciter", "Atari",
+	"Commodore", "Macintosh", "Apple", "speech",
+};
+#define NUM_BENCH_WORDS (sizeof(bench_words)/sizeof(bench_words[0]))
+
+// small deterministic pseudo random number generator (xorshift32), so the generated corpora are the same everywhere
+u32 benchRandom(u32* state)
+{
+	u32 x = *state;
+	x ^= x << 13;
+	x ^= x >> 17;
+	x ^= x << 5;
+	return *state = x;
+}
+
+// append a string to a vector, growing it as needed
+bool benchAppend(vec_u8* v, const char* str)
+{
+	for (; *str; str++)
+	{
+		if (!vec_u8_append(v, *str)) return false;
+	}
+	return true;
+}
+
+#define CORPUS_WORDS 0 // dictionary word list, one word per line
+#define CORPUS_PROSE 1 // sentences of words, with commas and periods
+#define CORPUS_DIGITS 2 // numbers, prices, dates, times and phone numbers between words
+#define CORPUS_PUNCT 3 // words surrounded by all kinds of punctuation
+#define NUM_CORPORA 4
+static const char* const corpus_names[NUM_CORPORA] = { "words", "prose", "digits", "punct" };
+
+// generate about size bytes of a built in corpus
+vec_u8* generateCorpus(const u32 kind, const u32 size)
+{
+	vec_u8* v = vec_u8_alloc(size + 64);
+	u32 seed = 0x2545f491 + kind;
+	u32 n = 0;
+	bool ok = (v->data != NULL);
+	char buf[64];
+	while (ok && (v->elements < size))
+	{
+		const char* const word = bench_words[benchRandom(&seed) % NUM_BENCH_WORDS];
+		const u32 r = benchRandom(&seed);
+		switch (kind)
+		{
+			case CORPUS_WORDS:
+				ok = benchAppend(v, bench_words[n++ % NUM_BENCH_WORDS]) && benchAppend(v, "\n");
+				break;
+			case CORPUS_PROSE:
+			{
+				// sentences of twelve words, starting with a capital letter
+				const bool first = ((n++ % 12) == 0);
+				snprintf(buf, sizeof(buf), "%s%c%s", first ? "" : " ", first ? toupper(word[0]) : word[0], &word[1]);
+				ok = benchAppend(v, buf);
+				if (ok && (r % 16 == 0)) ok = benchAppend(v, ",");
+				if (ok && (n % 12 == 0)) ok = benchAppend(v, ".");
+				break;
+			}
+			case CORPUS_DIGITS:
+				switch (r % 6)
+				{
+					case 0: snprintf(buf, sizeof(buf), "%s %d ", word, r % 10000); break;
+					case 1: snprintf(buf, sizeof(buf), "%s $%d.%02d ", word, (r >> 4) % 1000, (r >> 14) % 100); break;
+					case 2: snprintf(buf, sizeof(buf), "%d/%d/%d ", 1 + (r >> 3) % 12, 1 + (r >> 7) % 28, 1970 + (r >> 12) % 60); break;
+					case 3: snprintf(buf, sizeof(buf), "%d:%02d %s ", 1 + (r >> 3) % 12, (r >> 7) % 60, word); break;
+					case 4: snprintf(buf, sizeof(buf), "%03d-%04d ", (r >> 3) % 1000, (r >> 13) % 10000); break;
+					default: snprintf(buf, sizeof(buf), "%s %d.%d%% ", word, (r >> 3) % 100, (r >> 10) % 10); break;
+				}
+				ok = benchAppend(v, buf);
+				break;
+			case CORPUS_PUNCT:
+			{
+				static const char* const wrap[] = { "\"%s\" ", "(%s) ", "%s! ", "%s? ", "%s; ", "%s: ", "'%s' ", "%s-", "%s, ", "%s... ", "<%s> ", "*%s* ", "%s & ", "#%s ", "%s@%s ", "%s+%s=" };
+				snprintf(buf, sizeof(buf), wrap[r % 16], word, bench_words[(r >> 8) % NUM_BENCH_WORDS]);
+				ok = benchAppend(v, buf);
+				break;
+			}
+		}
+	}
+	if (!ok)
+	{
+		vec_u8_free(v);
+		return NULL;
+	}
+	return v;
+}
+
+// read a whole file into a vector
+vec_u8* readCorpus(const char* name)
+{
+	FILE* in = fopen(name, "rb");
+	if (!in) return NULL;
+	vec_u8* v = vec_u8_alloc(4096);
+	int ch;
+	while (v->data && ((ch = fgetc(in)) != EOF))
+	{
+		if (!vec_u8_append(v, ch)) break;
+	}
+	const bool ok = v->data && feof(in);
+	fclose(in);
+	if (!ok)
+	{
+		vec_u8_free(v);
+		return NULL;
+	}
+	return v;
+}
+
+// number of words in a corpus, counted as runs of letters
+u64 countWords(const vec_u8* v)
+{
+	u64 words = 0;
+	bool in_word = false;
+	for (u32 i = 0; i < v->elements; i++)
+	{
+		const bool letter = isalpha(v->data[i]);
+		if (letter && !in_word) words++;
+		in_word = letter;
+	}
+	return words;
+}
+
+// copy a raw corpus into a phrase vector with room for preProcess
+void loadPhrase(vec_u8* phrase, const vec_u8* raw)
+{
+	memcpy(&phrase->data[1], raw->data, raw->elements);
+	phrase->elements = raw->elements + 1;
+}
+
+typedef struct bench_lookup
+{
+	u32 pos; // of the lookup in the preprocessed phrase
+	u8 table;
+} bench_lookup;
+
+// find every position where processPhrase() looks a rule up, and in which table, by walking the phrase the same way
+u32 findLookups(const sym_ruleset* const ruleset, const vec_u8* const phrase, bench_lookup* lookups, vec_u8* output, s_cfg c)
+{
+	u32 n = 0;
+	for (s32 pos = 1; (pos < (s32)phrase->elements) && (phrase->data[pos] != RECITER_END_CHAR); pos++)
+	{
+		const u8 ch = phrase->data[pos];
+		s32 table = -1;
+		if (ch == '.')
+		{
+			// a period followed by a digit looks the digit up; processPhrase skips the character after any other period
+			if (isDigit(phrase->data[++pos], c)) table = RULES_PUNCT_DIGIT;
+		}
+		else if (isPunct(ch, c)) table = RULES_PUNCT_DIGIT;
+		else if ((c.ascii_features[ch&0x7f]&A_LETTER) && (ch >= 'A') && (ch <= 'Z')) table = ch - 'A';
+		if (table < 0) continue;
+		lookups[n].pos = pos;
+		lookups[n].table = table;
+		n++;
+		output->elements = 0;
+		const s32 next = processRule(ruleset[table], phrase, pos, output, c);
+		if (next < 0) return n;
+		pos = next;
+	}
+	return n;
+}
+
+// timing results of one benchmark
+#define BENCH_MAX_REPS 10000
+typedef struct bench_result
+{
+	double t[BENCH_MAX_REPS]; // seconds per repetition
+	u32 reps;
+} bench_result;
+
+int compareDouble(const void* a, const void* b)
+{
+	const double x = *(const double*)a;
+	const double y = *(const double*)b;
+	return (x > y) - (x < y);
+}
+
+double percentile(const bench_result* r, const double q)
+{
+	return r->t[(u32)(q * (r->reps - 1) + 0.5)];
+}
+
+// print a result row; items is the number of characters, lookups, or words per repetition, of the unit named
+bool json_first = true;
+void printResult(const bool json, const char* bench, const char* corpus, const char table, bench_result* r, const u64 chars, const u64 words, const u64 lookups, const u64 writes)
+{
+	qsort(r->t, r->reps, sizeof(double), compareDouble);
+	const double median = percentile(r, 0.5);
+	const double chars_s = median ? chars / median : 0;
+	const double words_s = median ? words / median : 0;
+	const double lookups_s = median ? lookups / median : 0;
+	const double writes_mb = chars ? writes * 1e6 / chars : 0;
+	if (json)
+	{
+		printf("%s\t{ \"benchmark\": \"%s\", \"corpus\": \"%s\", \"table\": \"%c\", \"reps\": %d, \"min\": %.9f, \"p50\": %.9f, \"p90\": %.9f, \"p99\": %.9f, \"max\": %.9f, \"chars\": %llu, \"words\": %llu, \"lookups\": %llu, \"chars_per_s\": %.1f, \"words_per_s\": %.1f, \"lookups_per_s\": %.1f, \"writes\": %llu, \"writes_per_mb\": %.2f }", json_first ? "" : ",\n", bench, corpus, table, r->reps, r->t[0], median, percentile(r, 0.9), percentile(r, 0.99), r->t[r->reps-1], (unsigned long long)chars, (unsigned long long)words, (unsigned long long)lookups, chars_s, words_s, lookups_s, (unsigned long long)writes, writes_mb);
+		json_first = false;
+	}
+	else
+	{
+		printf("%s,%s,%c,%d,%.9f,%.9f,%.9f,%.9f,%.9f,%llu,%llu,%llu,%.1f,%.1f,%.1f,%llu,%.2f\n", bench, corpus, table, r->reps, r->t[0], median, percentile(r, 0.9), percentile(r, 0.99), r->t[r->reps-1], (unsigned long long)chars, (unsigned long long)words, (unsigned long long)lookups, chars_s, words_s, lookups_s, (unsigned long long)writes, writes_mb);
+	}
+	fflush(stdout);
+}
+
+void usage()
+{
+	printf("Usage: reciter_bench [options]\n");
+	printf("Times preProcess and classifyInput, processRule per rule table, processPhrase, and translateInput with its\n");
+	printf("output written out over a set of corpora\n");
+	printf("\n");
+	printf("Options:\n");
+	printf("  -n <n>      timed repetitions of each benchmark (default 20)\n");
+	printf("  -w <n>      untimed warmup repetitions of each benchmark (default 3)\n");
+	printf("  -s <n>      size of each generated corpus in bytes (default 65536)\n");
+	printf("  -i <file>   also run the benchmarks over a file; can be given several times\n");
+	printf("  -g          don't use the generated corpora, only the files given with -i\n");
+	printf("  -j          print the results as JSON rather than CSV\n");
+	printf("  -m <name>   rule matcher: interp or dfa\n");
+	printf("  -r <spec>   ruleset version and rule switches, as for reciter\n");
+}
+
+#define BENCH_MAX_FILES 16
+
+int main(int argc, char **argv)
+{
+	s_cfg c = default_cfg;
+	s_stats stats = {0};
+	c.stats = &stats;
+	c.verbose = 0;
+	u32 rules_version = RULES_DEFAULT;
+	u32 rules_flags = RULES_FLAGS_DEFAULT;
+	u32 reps = 20;
+	u32 warmup = 3;
+	u32 size = 65536;
+	bool generated = true;
+	bool json = false;
+	const char* files[BENCH_MAX_FILES];
+	u32 num_files = 0;
+
+	// handle optional parameters
+	u32 paramidx = 1;
+	while (paramidx <= (argc-1))
+	{
+		switch (*(argv[paramidx]++))
+		{
+			case '-':
+				// skip this character.
+				break;
+			case 'n':
+				paramidx++;
+				if ((paramidx == argc) || (!sscanf(argv[paramidx], "%u", &reps)) || (!reps) || (reps > BENCH_MAX_REPS)) { e_printf(V_ERR,"E* Unable to parse argument for -n parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 'w':
+				paramidx++;
+				if ((paramidx == argc) || (!sscanf(argv[paramidx], "%u", &warmup))) { e_printf(V_ERR,"E* Unable to parse argument for -w parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 's':
+				paramidx++;
+				if ((paramidx == argc) || (!sscanf(argv[paramidx], "%u", &size)) || (!size) || (size > 0x10000000)) { e_printf(V_ERR,"E* Unable to parse argument for -s parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 'i':
+				paramidx++;
+				if ((paramidx == argc) || (num_files == BENCH_MAX_FILES)) { e_printf(V_ERR,"E* Too few arguments for -i parameter, or too many files!\n"); usage(); exit(1); }
+				files[num_files++] = argv[paramidx];
+				paramidx++;
+				break;
+			case 'g':
+				generated = false;
+				break;
+			case 'j':
+				json = true;
+				break;
+			case 'm':
+				paramidx++;
+				if (paramidx == argc) { e_printf(V_ERR,"E* Too few arguments for -m parameter!\n"); usage(); exit(1); }
+				for (c.matcher = 0; c.matcher < NUM_MATCHERS; c.matcher++)
+				{
+					if (!strcmp(matcher_names[c.matcher], argv[paramidx])) break;
+				}
+				if ((c.matcher == NUM_MATCHERS) || (c.matcher == MATCHER_CHECK)) { e_printf(V_ERR,"E* Unknown matcher %s for -m parameter!\n", argv[paramidx]); usage(); exit(1); }
+				paramidx++;
+				break;
+			case 'r':
+				paramidx++;
+				if ((paramidx == argc) || (!parseRuleSpec(argv[paramidx], &rules_version, &rules_flags))) { e_printf(V_ERR,"E* Unable to parse ruleset for -r parameter!\n"); usage(); exit(1); }
+				paramidx++;
+				break;
+			case '\0':
+				// end of string for parameter, go to next param
+				paramidx++;
+				break;
+			default:
+				{ e_printf(V_ERR,"E* Invalid option!\n"); usage(); exit(1); }
+				break;
+		}
+	}
+
+	rule_library lib;
+	const char* malformed;
+	if (!initRuleLibrary(&lib, &malformed))
+	{
+		if (malformed) e_printf(V_ERR,"E* Malformed rule %s, aborting!\n", malformed);
+		else e_printf(V_ERR,"E* Unable to compile rulesets, aborting!\n");
+		freeRuleLibrary(&lib);
+		return 1;
+	}
+	const rule_handle* handle = findRuleHandle(&lib, rules_version, rules_flags);
+	rule_tables tables;
+	initRuleTables(&tables, handle);
+	const sym_ruleset* const ruleset = tables.ruleset;
+	c.rules_version = handle->variant->version;
+
+	if (json) printf("{ \"ruleset\": \"%s\", \"rule_switches\": %d, \"matcher\": \"%s\", \"warmup\": %d, \"results\": [\n", handle->variant->name, handle->flags, matcher_names[c.matcher], warmup);
+	else printf("benchmark,corpus,table,reps,min,p50,p90,p99,max,chars,words,lookups,chars_per_s,words_per_s,lookups_per_s,writes,writes_per_mb\n");
+
+	bench_result* r = malloc(sizeof(bench_result));
+	vec_u8* output = vec_u8_alloc(4096);
+	c.features = vec_u8_alloc(4096);
+	FILE* null_out = fopen(BENCH_NULL_DEVICE, "wb");
+	bool ok = (r && output->data && c.features->data);
+	if (!null_out)
+	{
+		e_printf(V_ERR,"E* Unable to open %s for writing!\n", BENCH_NULL_DEVICE);
+		ok = false;
+	}
+	for (u32 k = generated ? 0 : NUM_CORPORA; ok && (k < NUM_CORPORA + num_files); k++)
+	{
+		const char* const name = (k < NUM_CORPORA) ? corpus_names[k] : files[k - NUM_CORPORA];
+		vec_u8* raw = (k < NUM_CORPORA) ? generateCorpus(k, size) : readCorpus(name);
+		if (!raw)
+		{
+			e_printf(V_ERR,"E* Unable to %s corpus %s!\n", (k < NUM_CORPORA) ? "generate" : "read", name);
+			ok = false;
+			break;
+		}
+		const u64 chars = raw->elements;
+		const u64 words = countWords(raw);
+		vec_u8* phrase = vec_u8_alloc(raw->elements + 2 + RECITER_PAD);
+		bench_lookup* lookups = malloc((raw->elements + 1) * sizeof(bench_lookup));
+		if ((!phrase->data) || (!lookups))
+		{
+			e_printf(V_ERR,"E* Failure to allocate memory for corpus %s!\n", name);
+			ok = false;
+		}
+
+		// preProcess
+		for (u32 i = 0; ok && (i < warmup + reps); i++)
+		{
+			loadPhrase(phrase, raw);
+			const double t = benchSeconds();
+			preProcess(phrase, c);
+			ok = classifyInput(phrase, c.features, c);
+			if (i >= warmup) r->t[i - warmup] = benchSeconds() - t;
+		}
+		r->reps = reps;
+		if (ok) printResult(json, "preprocess", name, '-', r, chars, words, 0, 0);
+
+		// processRule, a table at a time
+		const u32 num_lookups = ok ? findLookups(ruleset, phrase, lookups, output, c) : 0;
+		for (u32 table = 0; ok && (table < RULES_TOTAL); table++)
+		{
+			u64 n = 0;
+			for (u32 l = 0; l < num_lookups; l++)
+			{
+				n += (lookups[l].table == table);
+			}
+			if (!n) continue;
+			for (u32 i = 0; i < warmup + reps; i++)
+			{
+				const double t = benchSeconds();
+				for (u32 l = 0; l < num_lookups; l++)
+				{
+					if (lookups[l].table != table) continue;
+					output->elements = 0;
+					processRule(ruleset[table], phrase, lookups[l].pos, output, c);
+				}
+				if (i >= warmup) r->t[i - warmup] = benchSeconds() - t;
+			}
+			printResult(json, "rule", name, (table == RULES_PUNCT_DIGIT) ? '?' : 'A'+table, r, 0, 0, n, 0);
+		}
+
+		// processPhrase
+		for (u32 i = 0; ok && (i < warmup + reps); i++)
+		{
+			output->elements = 0;
+			const double t = benchSeconds();
+			const reciter_status status = processPhrase(ruleset, phrase, 0, phrase->elements, output, c);
+			if (i >= warmup) r->t[i - warmup] = benchSeconds() - t;
+			if (status != RECITER_OK)
+			{
+				e_printf(V_ERR,"E* Unable to translate corpus %s: %s\n", name, reciter_strerror(status));
+				ok = false;
+			}
+		}
+		if (ok) printResult(json, "phrase", name, '-', r, chars, words, num_lookups, 0);
+
+		// translateInput, written out
+		u64 writes = 0;
+		for (u32 i = 0; ok && (i < warmup + reps); i++)
+		{
+			input_file f;
+			memset(&f, 0, sizeof(f));
+			f.data = raw->data;
+			f.len = raw->elements;
+			output_writer w;
+			stats.output_writes = 0;
+			const double t = benchSeconds();
+			ok = outputOpen(&w, null_out, &stats);
+			ok = ok && translateInput(ruleset, &f, output, &w, c);
+			ok = outputClose(&w) && ok;
+			if (i >= warmup) r->t[i - warmup] = benchSeconds() - t;
+			writes = stats.output_writes;
+			if (!ok) e_printf(V_ERR,"E* Unable to translate corpus %s with translateInput!\n", name);
+		}
+		if (ok) printResult(json, "output", name, '-', r, chars, words, num_lookups, writes);
+
+		free(lookups);
+		vec_u8_free(phrase);
+		vec_u8_free(raw);
+	}
+	if (json) printf("\n] }\n");
+
+	free(r);
+	if (null_out) fclose(null_out);
+	vec_u8_free(c.features);
+	vec_u8_free(output);
+	freeRuleTables(&tables);
+	freeRuleLibrary(&lib);
+	return !ok;
+}